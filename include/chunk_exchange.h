@@ -0,0 +1,122 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHUNKEXCHANGEHEADERDEF
+#define CHUNKEXCHANGEHEADERDEF
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * A buffer which is passed between the two sides of a chunk_exchange.
+ * len is the number of valid bytes, and a chunk with len==0 marks the end
+ * of the data (error is set if the producer stopped because of an error).
+ */
+struct chunk {
+  std::vector<char> data;
+  std::size_t len;
+  bool error;
+};
+
+/**
+ * The chunk_exchange class lets one thread fill buffers while another
+ * thread drains them, e.g. reading a file from disk while the previous
+ * chunk is being sent over the network.  A fixed number of buffers
+ * circulate between the two threads, so memory use is bounded by
+ * nbuf*chunk_size no matter how big the file is.
+ */
+
+class chunk_exchange {
+
+  public:
+
+    /**
+     * ctor
+     *
+     * @param[in] nbuf number of buffers (2 gives double buffering).
+     * @param[in] chunk_size size of each buffer in bytes.
+     */
+    chunk_exchange(const unsigned int nbuf, const std::size_t chunk_size) : chunks(nbuf) {
+      for (auto& c : chunks) {
+        c.data.resize(chunk_size);
+        c.len = 0;
+        c.error = false;
+        empty.push_back(&c);
+      }
+    }
+
+    /**
+     * Method for getting an empty buffer to fill.  Blocks until one is free.
+     */
+    chunk* get_empty() {
+      return take(empty);
+    }
+
+    /**
+     * Method for handing a filled buffer to the other side.
+     */
+    void put_full(chunk* c) {
+      give(full,c);
+    }
+
+    /**
+     * Method for getting the next filled buffer.  Blocks until one arrives.
+     */
+    chunk* get_full() {
+      return take(full);
+    }
+
+    /**
+     * Method for returning a drained buffer so it can be filled again.
+     */
+    void put_empty(chunk* c) {
+      give(empty,c);
+    }
+
+  private:
+
+    std::vector<chunk> chunks;
+    std::deque<chunk*> empty;
+    std::deque<chunk*> full;
+    std::mutex mtx;
+    std::condition_variable changed;
+
+    chunk* take(std::deque<chunk*>& q) {
+      std::unique_lock<std::mutex> lock(mtx);
+      changed.wait(lock,[&q] () {return !q.empty();});
+      chunk* c = q.front();
+      q.pop_front();
+      return c;
+    }
+
+    void give(std::deque<chunk*>& q, chunk* c) {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        q.push_back(c);
+      }
+      changed.notify_all();
+    }
+
+    chunk_exchange(const chunk_exchange&);
+    chunk_exchange& operator=(const chunk_exchange&);
+
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONNECTIONPOOLHEADERDEF
+#define CONNECTIONPOOLHEADERDEF
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "remote_tools.h"
+
+class connection_pool;
+
+/**
+ * A connection which has been checked out of a connection_pool.  It is
+ * returned to the pool when it goes out of scope.  Only the thread holding
+ * it may use the connection, but every method opens its own channel so
+ * the holder can run any number of operations on it.
+ */
+class pooled_connection {
+
+  public:
+    pooled_connection(pooled_connection&& other);
+    ~pooled_connection();
+    connection* operator->() const;
+    connection& operator*() const;
+
+  private:
+    friend class connection_pool;
+    pooled_connection(connection_pool* pool, const std::string target, connection* conn);
+    pooled_connection(const pooled_connection&);
+    pooled_connection& operator=(const pooled_connection&);
+
+    connection_pool* pool;
+    std::string target;
+    connection* conn;
+
+};
+
+/**
+ * The connection_pool class keeps up to N authenticated ssh sessions per
+ * host so that the handshake and public key authentication are only done
+ * once per session.  Sessions are opened the first time they are needed,
+ * and checkout blocks while all N sessions to a host are in use.  A
+ * background thread sends keepalives on idle sessions, and sessions which
+ * have dropped are reopened on the next checkout.
+ */
+class connection_pool {
+
+  public:
+    connection_pool(const unsigned int sessions_per_host, const unsigned int keepalive_s=60);
+    ~connection_pool();
+    pooled_connection checkout(const std::string target);
+
+  private:
+    friend class pooled_connection;
+    void checkin(const std::string& target, connection* conn);
+    void keepalive_loop();
+
+    struct host_sessions {
+      std::vector<std::unique_ptr<connection> > all;
+      std::vector<connection*> idle;
+    };
+
+    unsigned int max_sessions;
+    unsigned int keepalive_interval;
+    bool running;
+    std::map<std::string,host_sessions> hosts;
+    std::mutex mtx;
+    std::condition_variable available;
+    std::condition_variable stopping;
+    std::thread keepalive_thread;
+
+    connection_pool(const connection_pool&);
+    connection_pool& operator=(const connection_pool&);
+
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ERRORSHEADERDEF
+#define ERRORSHEADERDEF
+
+#include <string>
+#include <stdexcept>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <random>
+
+/**
+ * Exceptions thrown by cpp-opt.  Everything derives from cppopt_error, so
+ * a driver which runs many evaluations can catch that, mark the
+ * evaluation as failed and carry on with the rest.
+ *
+ *   file_error   : a local file or directory couldn't be read, written, copied, etc.
+ *   parse_error  : a value wasn't where it was expected in a file or output.
+ *   remote_error : something failed on or on the way to a remote host.  If
+ *                  transient() is true (dropped connection, channel
+ *                  failure, timeout) the operation is worth retrying.
+ */
+
+class cppopt_error : public std::runtime_error {
+  public:
+    explicit cppopt_error(const std::string& what) : std::runtime_error(what) {}
+};
+
+class file_error : public cppopt_error {
+  public:
+    explicit file_error(const std::string& what) : cppopt_error(what) {}
+};
+
+class parse_error : public cppopt_error {
+  public:
+    explicit parse_error(const std::string& what) : cppopt_error(what) {}
+};
+
+class remote_error : public cppopt_error {
+  public:
+    explicit remote_error(const std::string& what, const bool transient=false) : cppopt_error(what), is_transient(transient) {}
+    bool transient() const {
+      return is_transient;
+    }
+  private:
+    bool is_transient;
+};
+
+/**
+ * How with_retry retries an operation.  The delay before retry n is
+ * initial_delay_ms*backoff^(n-1), capped at max_delay_ms.  With jitter,
+ * each delay is picked at random between half and all of that, so that
+ * many workers which failed together don't all retry together.
+ */
+struct retry_policy {
+  unsigned int max_attempts;
+  long initial_delay_ms;
+  double backoff;
+  long max_delay_ms;
+  bool jitter;
+  retry_policy() : max_attempts(4), initial_delay_ms(500), backoff(2.0), max_delay_ms(30000), jitter(true) {}
+};
+
+/**
+ * The with_retry function calls f until it succeeds, retrying when it
+ * throws a transient remote_error.  Any other exception, or a transient
+ * one on the last attempt, is passed on to the caller.
+ *
+ * @param f operation to be run (any callable without arguments).
+ * @param policy number of attempts and delays (see retry_policy).
+ * @param on_retry called with the error and the attempt number before each retry (optional).
+ * @return What f returns.
+ */
+template <typename F>
+auto with_retry(F f, const retry_policy policy=retry_policy(), std::function<void(const remote_error&, unsigned int)> on_retry=nullptr) -> decltype(f()) {
+  static thread_local std::minstd_rand rng(std::random_device{}());
+  double delay = static_cast<double>(policy.initial_delay_ms);
+  for (unsigned int attempt=1; ; ++attempt) {
+    try {
+      return f();
+    }
+    catch (const remote_error& e) {
+      if (!e.transient() || attempt>=policy.max_attempts) {
+        throw;
+      }
+      if (on_retry) {
+        on_retry(e,attempt);
+      }
+    }
+    double wait_ms = (delay<policy.max_delay_ms) ? delay : policy.max_delay_ms;
+    if (policy.jitter) {
+      wait_ms *= std::uniform_real_distribution<double>(0.5,1.0)(rng);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<long>(wait_ms)));
+    delay *= policy.backoff;
+  }
+}
+
+#endif
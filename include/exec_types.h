@@ -0,0 +1,113 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXECTYPESHEADERDEF
+#define EXECTYPESHEADERDEF
+
+#include <string>
+#include <cstddef>
+#include <atomic>
+#include <functional>
+
+/**
+ * Types which are shared by everything that runs commands (connection,
+ * the executors and the job managers), so that code which uses them
+ * doesn't depend on where the command runs.
+ */
+
+/**
+ * A value to be read from a file (see connection::get_remote_fields and
+ * executor::get_fields).  If label is empty, the value is field pos of
+ * line line_num, as in get_value.  Otherwise it's field pos of the first
+ * line whose first field is label (pos 0 is the label itself), as in
+ * report_table::get.
+ */
+struct remote_value {
+  std::string file;
+  std::string label;
+  unsigned int line_num;
+  unsigned int pos;
+  remote_value(const std::string file, const unsigned int line_num, const unsigned int pos) : file(file), line_num(line_num), pos(pos) {}
+  remote_value(const std::string file, const std::string label, const unsigned int pos) : file(file), label(label), line_num(0), pos(pos) {}
+};
+
+/**
+ * Output of a command (see connection::exec).  exit_status is -1 if the
+ * command timed out or didn't report a status.
+ */
+struct exec_result {
+  std::string out;
+  std::string err;
+  int exit_status;
+  bool timed_out;
+};
+
+/**
+ * Options for running a command.
+ *
+ *   chunk_size : bytes read from the command's output at a time.
+ *   timeout_ms : time after which the command is killed (negative waits forever).
+ *   on_stdout  : if set, stdout is passed to it as it arrives instead of being kept in exec_result::out.
+ *   input      : if not empty, written to the command's stdin, which is then closed.
+ *   cancel     : if set, the command is killed once it becomes true (checked at least every 50 ms).
+ */
+struct exec_options {
+  std::size_t chunk_size;
+  long timeout_ms;
+  std::function<void(const char*, std::size_t)> on_stdout;
+  std::string input;
+  const std::atomic<bool>* cancel;
+  exec_options() : chunk_size(16384), timeout_ms(-1), cancel(NULL) {}
+};
+
+/**
+ * Quotes a path for a POSIX shell.  The path is put in single quotes, so
+ * nothing in it ($, backticks, spaces, ...) is expanded.  A leading ~ or
+ * $HOME is left outside the quotes as "$HOME", so paths relative to the
+ * home directory still work.
+ *
+ * @param[in] path path to be quoted.
+ * @return The quoted path.
+ */
+inline std::string shell_quote(const std::string& path) {
+  std::string quoted;
+  std::string rest = path;
+  const char* prefixes[] = {"~", "$HOME"};
+  for (const char* prefix : prefixes) {
+    std::size_t n = std::string(prefix).size();
+    if (path.compare(0,n,prefix)==0 && (path.size()==n || path[n]=='/')) {
+      quoted = "\"$HOME\"";
+      rest = path.substr(n);
+      break;
+    }
+  }
+  if (rest.empty() && !quoted.empty()) {
+    return quoted;
+  }
+  quoted += '\'';
+  for (char c : rest) {
+    if (c=='\'') {
+      quoted += "'\\''";
+    }
+    else {
+      quoted += c;
+    }
+  }
+  return quoted + "'";
+}
+
+#endif
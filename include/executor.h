@@ -0,0 +1,406 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXECUTORHEADERDEF
+#define EXECUTORHEADERDEF
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <spawn.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <boost/lexical_cast.hpp>
+#include "exec_types.h"
+#include "errors.h"
+#include "file_ops.h"
+
+extern char** environ;
+
+/**
+ * The executor class is the interface which evaluation code uses to run
+ * a case, so that the same objective function works on the local machine
+ * and on a cluster.  An executor can:
+ *
+ *   - stage a local file into a directory where the case runs,
+ *   - run a command there and capture its output and exit status,
+ *   - read values from the files the command wrote, or fetch the files.
+ *
+ * local_executor does all of this directly (posix_spawn and pipes, plain
+ * file access) and ssh_executor (ssh_executor.h) does it over a connection.
+ */
+
+class executor {
+
+  public:
+
+    virtual ~executor() {}
+
+    /**
+     * Method for copying a local file into a directory where the case runs.
+     *
+     * @param[in] local_file file to be copied.
+     * @param[in] dest_dir directory into which it's copied.
+     */
+    virtual void stage(const std::string local_file, const std::string dest_dir) = 0;
+
+    /**
+     * Method for running a command and waiting for it.
+     *
+     * @param[in] cmd command passed to the shell.
+     * @param[in] opts timeout etc. (see exec_options).
+     * @return stdout, stderr and the exit status.
+     */
+    virtual exec_result run(const std::string cmd, const exec_options opts=exec_options()) = 0;
+
+    /**
+     * Method for copying a file written by a case back to the local machine.
+     *
+     * @param[in] file path of the file where the case ran.
+     * @param[in] local_file where the copy goes.
+     */
+    virtual void fetch(const std::string file, const std::string local_file) = 0;
+
+    /**
+     * Method for reading fields from files written by a case without
+     * copying the files.
+     *
+     * @param[in] values the files, lines/labels and positions of the fields.
+     * @return The fields, in the same order as values.
+     */
+    virtual std::vector<std::string> get_fields(const std::vector<remote_value>& values) = 0;
+
+    /**
+     * Method for getting the executor working again after a transient
+     * error (e.g., reopening a dropped connection).  Does nothing by default.
+     */
+    virtual void reconnect() {}
+
+    /**
+     * Method for identifying the connection the executor runs commands
+     * over, so that callers which use executors from several threads can
+     * check that no two of them share one.
+     *
+     * @return The connection, or NULL if the executor doesn't use one.
+     */
+    virtual const void* connection_id() const {
+      return NULL;
+    }
+
+    /**
+     * Method for reading one value.  Same semantics as get_value.
+     */
+    template <typename T>
+    T get(const std::string file, const unsigned int line_num, const unsigned int pos) {
+      std::vector<remote_value> values(1,remote_value(file,line_num,pos));
+      return convert<T>(get_fields(values)[0],values[0]);
+    }
+
+    /**
+     * Method for reading one value from a labeled line (pos 0 is the label).
+     */
+    template <typename T>
+    T get(const std::string file, const std::string label, const unsigned int pos) {
+      std::vector<remote_value> values(1,remote_value(file,label,pos));
+      return convert<T>(get_fields(values)[0],values[0]);
+    }
+
+  private:
+
+    // Converts a field, throwing a parse_error if it isn't a T
+    template <typename T>
+    static T convert(const std::string& field, const remote_value& v) {
+      try {
+        return boost::lexical_cast<T>(field);
+      }
+      catch (const boost::bad_lexical_cast&) {
+        std::ostringstream msg;
+        msg << "Can't convert " << field << " (";
+        if (v.label.empty()) {
+          msg << "line " << v.line_num;
+        }
+        else {
+          msg << "row " << v.label;
+        }
+        msg << ", index " << v.pos << " of " << v.file << ").";
+        throw parse_error(msg.str());
+      }
+    }
+
+};
+
+/**
+ * The local_executor class runs cases on this machine.  Commands are
+ * started with posix_spawn and their output is read through pipes, and
+ * files are staged and read in place, so a pipeline which normally runs
+ * on a cluster runs at full speed on a workstation or a CI machine.
+ */
+
+class local_executor : public executor {
+
+  public:
+
+    /**
+     * ctor
+     *
+     * @param[in] work_dir directory in which commands run (empty means the current directory).
+     */
+    explicit local_executor(const std::string work_dir="") : work_dir(work_dir) {}
+
+    void stage(const std::string local_file, const std::string dest_dir) {
+      std::string dir = path_of(dest_dir);
+      if (!accessible(dir)) {
+        make_dir(dir);
+      }
+      std::string name = local_file.substr(local_file.find_last_of('/')+1);
+      copy_file(local_file,dir + "/" + name);
+    }
+
+    exec_result run(const std::string cmd, const exec_options opts=exec_options()) {
+
+      exec_result res;
+      res.exit_status = -1;
+      res.timed_out = false;
+      std::string full_cmd = work_dir.empty() ? cmd : "cd " + shell_quote(work_dir) + " && " + cmd;
+      bool feed = !opts.input.empty();
+
+      // Pipes for stdout, stderr and stdin (close-on-exec, so that commands
+      // started at the same time from other threads don't hold them open)
+      int out_pipe[2] = {-1,-1}, err_pipe[2] = {-1,-1}, in_pipe[2] = {-1,-1};
+      auto close_pipes = [&out_pipe,&err_pipe,&in_pipe] () {
+        for (int* fd : {out_pipe,out_pipe+1,err_pipe,err_pipe+1,in_pipe,in_pipe+1}) {
+          if (*fd>=0) {
+            close(*fd);
+            *fd = -1;
+          }
+        }
+      };
+      if (pipe2(out_pipe,O_CLOEXEC)!=0 || pipe2(err_pipe,O_CLOEXEC)!=0 || (feed && pipe2(in_pipe,O_CLOEXEC)!=0)) {
+        int err = errno;
+        close_pipes();
+        std::ostringstream msg;
+        msg << "Can't create pipes: " << strerror(err);
+        throw cppopt_error(msg.str());
+      }
+      posix_spawn_file_actions_t actions;
+      posix_spawn_file_actions_init(&actions);
+      posix_spawn_file_actions_adddup2(&actions,out_pipe[1],STDOUT_FILENO);
+      posix_spawn_file_actions_adddup2(&actions,err_pipe[1],STDERR_FILENO);
+      if (feed) {
+        posix_spawn_file_actions_adddup2(&actions,in_pipe[0],STDIN_FILENO);
+      }
+
+      // Starting the command (in its own process group so a timeout kills everything it started)
+      posix_spawnattr_t attr;
+      posix_spawnattr_init(&attr);
+      posix_spawnattr_setflags(&attr,POSIX_SPAWN_SETPGROUP);
+      posix_spawnattr_setpgroup(&attr,0);
+      const char* argv[] = {"/bin/sh","-c",full_cmd.c_str(),NULL};
+      pid_t pid;
+      int rc = posix_spawn(&pid,"/bin/sh",&actions,&attr,const_cast<char* const*>(argv),environ);
+      posix_spawn_file_actions_destroy(&actions);
+      posix_spawnattr_destroy(&attr);
+      close(out_pipe[1]);
+      close(err_pipe[1]);
+      out_pipe[1] = err_pipe[1] = -1;
+      if (feed) {
+        close(in_pipe[0]);
+        in_pipe[0] = -1;
+        fcntl(in_pipe[1],F_SETFL,O_NONBLOCK);
+      }
+      if (rc!=0) {
+        close_pipes();
+        std::ostringstream msg;
+        msg << "Can't run " << cmd << ": " << strerror(rc);
+        throw cppopt_error(msg.str());
+      }
+
+      // A command which exits without reading all of its input mustn't kill us with SIGPIPE
+      sigset_t pipe_set, old_set;
+      sigemptyset(&pipe_set);
+      sigaddset(&pipe_set,SIGPIPE);
+      if (feed) {
+        pthread_sigmask(SIG_BLOCK,&pipe_set,&old_set);
+      }
+
+      // Feeding stdin and reading stdout and stderr until the command closes them
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      std::vector<char> buffer(opts.chunk_size>0 ? opts.chunk_size : 16384);
+      std::size_t input_sent = 0;
+      struct pollfd pfds[3];
+      pfds[0].fd = out_pipe[0];
+      pfds[1].fd = err_pipe[0];
+      pfds[2].fd = feed ? in_pipe[1] : -1;
+      pfds[0].events = pfds[1].events = POLLIN;
+      pfds[2].events = POLLOUT;
+      int open_pipes = 2;
+      while (open_pipes>0) {
+        int wait_ms = (opts.cancel!=NULL) ? 50 : -1;
+        if (opts.cancel!=NULL && opts.cancel->load()) {
+          kill(-pid,SIGKILL);
+          break;
+        }
+        if (opts.timeout_ms>=0) {
+          long left = opts.timeout_ms - std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+          if (left<=0) {
+            kill(-pid,SIGKILL);
+            res.timed_out = true;
+            break;
+          }
+          wait_ms = (wait_ms>=0 && wait_ms<left) ? wait_ms : static_cast<int>(left);
+        }
+        if (::poll(pfds,3,wait_ms)<0 && errno!=EINTR) {
+          break;
+        }
+        if (pfds[2].fd>=0 && (pfds[2].revents & (POLLOUT | POLLERR | POLLHUP))) {
+          ssize_t n = ::write(pfds[2].fd,opts.input.data()+input_sent,opts.input.size()-input_sent);
+          if (n>0) {
+            input_sent += n;
+          }
+          if ((n<0 && errno!=EAGAIN && errno!=EINTR) || input_sent==opts.input.size()) {
+            close(pfds[2].fd);
+            pfds[2].fd = -1;
+          }
+        }
+        for (int i=0; i<2; ++i) {
+          if (pfds[i].fd>=0 && (pfds[i].revents & (POLLIN | POLLHUP))) {
+            ssize_t n = read(pfds[i].fd,buffer.data(),buffer.size());
+            if (n>0 && i==0 && opts.on_stdout) {
+              opts.on_stdout(buffer.data(),n);
+            }
+            else if (n>0) {
+              (i==0 ? res.out : res.err).append(buffer.data(),n);
+            }
+            else if (n==0 || errno!=EINTR) {
+              close(pfds[i].fd);
+              pfds[i].fd = -1;
+              open_pipes--;
+            }
+          }
+        }
+      }
+      for (int i=0; i<3; ++i) {
+        if (pfds[i].fd>=0) {
+          close(pfds[i].fd);
+        }
+      }
+
+      // Throwing away a SIGPIPE which was raised while it was blocked
+      if (feed) {
+        struct timespec zero = {0,0};
+        while (sigtimedwait(&pipe_set,NULL,&zero)>0) {}
+        pthread_sigmask(SIG_SETMASK,&old_set,NULL);
+      }
+
+      // Collecting the exit status
+      int status;
+      while (waitpid(pid,&status,0)<0 && errno==EINTR) {}
+      if (!res.timed_out && WIFEXITED(status)) {
+        res.exit_status = WEXITSTATUS(status);
+      }
+      return res;
+
+    }
+
+    void fetch(const std::string file, const std::string local_file) {
+      copy_file(path_of(file),local_file);
+    }
+
+    std::vector<std::string> get_fields(const std::vector<remote_value>& values) {
+
+      // Reading each file once
+      std::map<std::string,std::vector<std::size_t> > by_file;
+      for (std::size_t i=0; i<values.size(); ++i) {
+        by_file[values[i].file].push_back(i);
+      }
+      std::vector<std::string> fields(values.size());
+      for (auto& kv : by_file) {
+        std::string filename = path_of(kv.first);
+        std::ifstream infile(filename.c_str());
+        if (!infile.is_open()) {
+          std::ostringstream msg;
+          msg << "Can't open " << filename;
+          throw file_error(msg.str());
+        }
+        std::vector<std::size_t> left(kv.second);
+        std::string line;
+        unsigned int line_counter = 0;
+        while (!left.empty() && getline(infile,line)) {
+          std::stringstream ss(line);
+          std::istream_iterator<std::string> begin(ss);
+          std::istream_iterator<std::string> end;
+          std::vector<std::string> sarray(begin,end);
+          for (std::size_t k=0; k<left.size();) {
+            const remote_value& v = values[left[k]];
+            bool match = v.label.empty() ? (line_counter==v.line_num) : (!sarray.empty() && sarray[0]==v.label);
+            if (!match) {
+              ++k;
+              continue;
+            }
+            if (v.pos>=sarray.size()) {
+              missing(v);
+            }
+            fields[left[k]] = sarray[v.pos];
+            left.erase(left.begin()+k);
+          }
+          line_counter++;
+        }
+        if (!left.empty()) {
+          missing(values[left[0]]);
+        }
+      }
+      return fields;
+
+    }
+
+  private:
+
+    std::string work_dir;
+
+    // Relative paths are relative to the work directory, as they are for commands
+    std::string path_of(const std::string& file) const {
+      return (work_dir.empty() || file.empty() || file[0]=='/') ? file : work_dir + "/" + file;
+    }
+
+    static void missing(const remote_value& v) {
+      std::ostringstream msg;
+      msg << "Didn't find field " << v.pos;
+      if (v.label.empty()) {
+        msg << " of line " << v.line_num;
+      }
+      else {
+        msg << " of the line labeled " << v.label;
+      }
+      msg << " in file named " << v.file;
+      throw parse_error(msg.str());
+    }
+
+};
+
+#endif
@@ -25,9 +25,189 @@
 #include <cstdlib>
 #include <vector>
 #include <iterator>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <exception>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
 #include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <unistd.h>
 #include "boost/lexical_cast.hpp"
+#include "errors.h"
+
+/**
+ * How hard atomic_file_writer tries to make sure that a rewritten file
+ * survives a crash of the machine (a crash of the process is always safe).
+ *
+ *   durability_none : no fsync, the rename is still atomic.
+ *   durability_file : the new contents are fsync-ed before the rename.
+ *   durability_full : the directory is also fsync-ed after the rename.
+ */
+enum durability { durability_none, durability_file, durability_full };
+
+/**
+ * The atomic_file_writer class replaces a file without ever leaving a
+ * partially written version of it behind.  Data is written through a fixed
+ * size buffer into a temporary file in the same directory, and commit()
+ * renames the temporary file over the original.  If commit() is never
+ * called, the temporary file is removed and the original is untouched.
+ * The permissions of the original file are kept.  Because the target is
+ * renamed over, a symlink at the target is replaced by a regular file (the
+ * file it pointed to is left as it was), and hard links to the original
+ * keep the old contents.
+ */
+
+class atomic_file_writer {
+
+  public:
+
+    /**
+     * ctor which creates the temporary file.
+     *
+     * @param[in] filename name of the file which will be replaced.
+     * @param[in] policy durability policy (see durability).
+     * @param[in] buffer_size size of the write buffer in bytes (default is 64 KiB).
+     */
+    atomic_file_writer(const std::string filename, const durability policy=durability_file, const std::size_t buffer_size=65536) : target(filename), policy(policy), committed(false) {
+
+      // Creating the temporary file next to the target so the rename is atomic
+      std::vector<char> tmpl(filename.begin(),filename.end());
+      const char suffix[] = ".XXXXXX";
+      tmpl.insert(tmpl.end(),suffix,suffix+sizeof(suffix));
+      fd = mkstemp(tmpl.data());
+      if (fd<0) {
+        std::ostringstream msg;
+        msg << "Can't create temporary file for " << filename << ": " << strerror(errno);
+        throw file_error(msg.str());
+      }
+      tmp_name = tmpl.data();
+
+      // Keeping the permissions of the original
+      struct stat ss;
+      if (stat(filename.c_str(),&ss)==0) {
+        fchmod(fd,ss.st_mode & 07777);
+      }
+
+      buffer.reserve(buffer_size);
+
+    }
+
+    /**
+     * dtor which removes the temporary file if commit wasn't called.
+     */
+    ~atomic_file_writer() {
+      if (!committed) {
+        if (fd>=0) {
+          close(fd);
+        }
+        unlink(tmp_name.c_str());
+      }
+    }
+
+    /**
+     * Method for writing data.  Data is only written to the file once the
+     * buffer is full.
+     *
+     * @param[in] data pointer to the data.
+     * @param[in] len number of bytes.
+     */
+    void write(const char* data, const std::size_t len) {
+      if (buffer.size()+len>buffer.capacity()) {
+        flush();
+        if (len>=buffer.capacity()) {
+          write_fd(data,len);
+          return;
+        }
+      }
+      buffer.append(data,len);
+    }
+
+    void write(const std::string& data) {
+      write(data.data(),data.size());
+    }
+
+    /**
+     * Method for replacing the target with everything that was written.
+     */
+    void commit() {
+
+      flush();
+      if (policy!=durability_none && fsync(fd)!=0) {
+        fail("Can't fsync");
+      }
+      // The descriptor is gone even if close fails, so the dtor mustn't close it again
+      int rc = close(fd);
+      fd = -1;
+      if (rc!=0) {
+        fail("Can't close");
+      }
+      if (rename(tmp_name.c_str(),target.c_str())!=0) {
+        fail("Can't rename");
+      }
+      committed = true;
+
+      // Making the rename itself durable
+      if (policy==durability_full) {
+        std::size_t slash = target.rfind('/');
+        std::string dir = (slash==std::string::npos) ? "." : target.substr(0,slash+1);
+        int dfd = open(dir.c_str(),O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd>=0) {
+          fsync(dfd);
+          close(dfd);
+        }
+      }
+
+    }
+
+  private:
+
+    std::string target;
+    std::string tmp_name;
+    durability policy;
+    bool committed;
+    int fd;
+    std::string buffer;
+
+    void fail(const char* what) {
+      std::ostringstream msg;
+      msg << what << " temporary file " << tmp_name << " for " << target << ": " << strerror(errno);
+      // The dtor removes the temporary file
+      throw file_error(msg.str());
+    }
+
+    void write_fd(const char* data, std::size_t len) {
+      while (len>0) {
+        ssize_t nbytes = ::write(fd,data,len);
+        if (nbytes<0) {
+          if (errno==EINTR) {
+            continue;
+          }
+          fail("Can't write to");
+        }
+        data += nbytes;
+        len -= nbytes;
+      }
+    }
+
+    void flush() {
+      write_fd(buffer.data(),buffer.size());
+      buffer.clear();
+    }
+
+    atomic_file_writer(const atomic_file_writer&);
+    atomic_file_writer& operator=(const atomic_file_writer&);
+
+};
 
 /**
  * The replace_var function opens the provided file and searches
@@ -35,18 +215,30 @@
  * replaced with the numeric value val.  This function is templated
  * so that any type can be substituted for the variable.
  *
+ * The file is streamed line by line into a temporary file which is then
+ * renamed over the original (see atomic_file_writer), so the original is
+ * never left half written and memory use doesn't grow with the file size.
+ * If filename is a symlink, it's replaced by a regular file.
+ *
+ * The default durability is durability_none: the rename is atomic, so a
+ * crash of the process never leaves a broken deck, but no fsync is paid on
+ * every edit.  A deck is normally rewritten once per evaluation and a
+ * machine crash loses the evaluation anyway.  Pass durability_file if the
+ * edited file has to survive a power loss.
+ *
  * @param filename name of the file that will be opened and searched.
  * @param var variable which will be searched for.
  * @param val value that will replace all occurences of the variable provided.
  * @numfmt used to set the number format of the std::ostringstream (optional, default is std::fixed).
+ * @policy durability policy used when replacing the file (optional, default is durability_none).
  *
  * Author        : James Grisham
  * Date          : 06/17/2015
- * Revision date :
+ * Revision date : 10/18/2026
  */
 
 template<typename T> 
-void replace_var(const std::string filename, const std::string var, const T val, const std::string numfmt="fixed") {
+void replace_var(const std::string filename, const std::string var, const T val, const std::string numfmt="fixed", const durability policy=durability_none) {
   
   // Declaring some variables
   std::size_t found;
@@ -55,52 +247,45 @@ void replace_var(const std::string filename, const std::string var, const T val,
   // Opening input file
   std::ifstream infile(filename.c_str());
   if(!infile.is_open()) {
-    std::cerr << "\nERROR: Can't open " << filename << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    std::ostringstream msg;
+    msg << "Can't open " << filename;
+    throw file_error(msg.str());
   }
 
+  // Formatting the value once
+  std::ostringstream valstring;
+  if (numfmt.compare("fixed")==0) {
+    valstring << std::fixed;
+  }
+  else if (numfmt.compare("scientific")==0) {
+    valstring << std::scientific;
+  }
+  valstring << val;
+  const std::string valstr = valstring.str();
+
   // Reading file line by line and searching for var and replacing
+  atomic_file_writer output(filename,policy);
   std::string line;
-  std::ostringstream output;
-  //output.precision(16);
-  output << std::fixed;
   while (getline(infile,line)) {
 
     // Searching line for var
     found = line.find(var);
     while (found!=std::string::npos) {
-      std::ostringstream valstring;
-      if (numfmt.compare("fixed")==0) {
-        valstring << std::fixed;
-      }
-      else if (numfmt.compare("scientific")==0) {
-        valstring << std::scientific;
-      }
-      valstring << val;
-      line.replace(line.find(var),var.length(),valstring.str());
+      line.replace(found,var.length(),valstr);
       found_var = true;
-      found = line.find(var);
+      found = line.find(var,found+valstr.length());
     }
-    output << line << "\n";
+    line += '\n';
+    output.write(line);
 
   }
 
   // Closing stream
   infile.close();
 
+  // Replacing the old file (the temporary file is removed if nothing was found)
   if (found_var) {
-
-    // Overwriting old file
-    std::ofstream outfile(filename.c_str());
-    if (!outfile.is_open()) {
-      std::cerr << "\nERROR: Can't open " << filename << " to write." << std::endl;
-      std::cerr << "Exiting.\n" << std::endl;
-      exit(-1);
-    }
-    outfile << output.str();
-    outfile.close();
-
+    output.commit();
   }
   else {
     std::cout << "WARNING: Did not find " << var << " in file named " << filename << std::endl;
@@ -120,37 +305,328 @@ void replace_var(const std::string filename, const std::string var, const T val,
  * Revision date :
  */
 
-bool accessible(const std::string name) {
+inline bool accessible(const std::string name) {
   struct stat ss;
   return stat(name.c_str(),&ss)==0;
 }
 
 /**
- * The copy_file function uses input and output streams to copy a file from
- * one place to another.
+ * Methods which can be used to place a file in a new location.  Reflinks
+ * share the data blocks of the source until one of the files is written
+ * (only on filesystems which support it, such as btrfs or XFS).  Hard links
+ * and symlinks share the file itself, so they must only be used for inputs
+ * which are never modified (e.g., meshes).
+ */
+enum copy_method { copy_method_copy, copy_method_reflink, copy_method_hardlink, copy_method_symlink };
+
+/**
+ * The copy_fd function copies the contents of one open file to another in
+ * the kernel.  A reflink is tried first, then copy_file_range, then
+ * sendfile.  Plain read/write is only used if none of those are supported.
+ *
+ * @param src_fd file descriptor of the source (open for reading).
+ * @param dst_fd file descriptor of the destination (open for writing, empty).
+ * @param size number of bytes in the source.
+ * @return Whether the copy succeeded.
+ */
+
+inline bool copy_fd(const int src_fd, const int dst_fd, const off_t size) {
+
+  // Sharing the data blocks if the filesystem allows it
+#ifdef FICLONE
+  if (ioctl(dst_fd,FICLONE,src_fd)==0) {
+    return true;
+  }
+#endif
+
+  // Copying in the kernel with copy_file_range
+  off_t remaining = size;
+  ssize_t nbytes = 0;
+  while (remaining>0) {
+    nbytes = copy_file_range(src_fd,NULL,dst_fd,NULL,remaining,0);
+    if (nbytes<=0) {
+      break;
+    }
+    remaining -= nbytes;
+  }
+  if (remaining==0) {
+    return true;
+  }
+
+  // copy_file_range isn't supported across some filesystems, so trying sendfile
+  if (nbytes<0 && errno!=EXDEV && errno!=ENOSYS && errno!=EINVAL && errno!=EOPNOTSUPP) {
+    return false;
+  }
+  while (remaining>0) {
+    nbytes = sendfile(dst_fd,src_fd,NULL,remaining);
+    if (nbytes<=0) {
+      break;
+    }
+    remaining -= nbytes;
+  }
+  if (remaining==0) {
+    return true;
+  }
+  if (nbytes<0 && errno!=EINVAL && errno!=ENOSYS) {
+    return false;
+  }
+
+  // Falling back to copying through a buffer
+  std::vector<char> buffer(1 << 20);
+  while (remaining>0) {
+    nbytes = read(src_fd,buffer.data(),buffer.size());
+    if (nbytes<0 && errno==EINTR) {
+      continue;
+    }
+    if (nbytes<=0) {
+      return false;
+    }
+    for (ssize_t written=0; written<nbytes; ) {
+      ssize_t w = write(dst_fd,buffer.data()+written,nbytes-written);
+      if (w<0 && errno==EINTR) {
+        continue;
+      }
+      if (w<0) {
+        return false;
+      }
+      written += w;
+    }
+    remaining -= nbytes;
+  }
+  return true;
+
+}
+
+/**
+ * The copy_file function copies a file from one place to another.  The
+ * copy is done in the kernel (see copy_fd) and the permissions of the
+ * source are kept, except that the copy is always writable by its owner.
+ * An existing destination is unlinked first, so a hard link to another
+ * file (e.g., a read-only input shared by clone_tree) isn't written through.
  *
  * @param source_file file to be copied.
  * @param dest_file destination.
  * 
  * Author        : James Grisham
  * Date          : 06/17/2015
- * Revision date :
+ * Revision date : 10/18/2026
  */
 
-void copy_file(const std::string source_file, const std::string dest_file) {
+inline void copy_file(const std::string source_file, const std::string dest_file) {
 
   // Checking to make sure the file is accessible
   if (!accessible(source_file)) {
-    std::cerr << "\nERROR: input file " << source_file << " not accessible." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
+    std::ostringstream msg;
+    msg << "input file " << source_file << " not accessible.";
+    throw file_error(msg.str());
+  }
+
+  // Opening both files
+  int src_fd = open(source_file.c_str(),O_RDONLY | O_CLOEXEC);
+  struct stat ss;
+  if (src_fd<0 || fstat(src_fd,&ss)!=0) {
+    std::ostringstream msg;
+    msg << "Can't open " << source_file << ": " << strerror(errno);
+    if (src_fd>=0) {
+      close(src_fd);
+    }
+    throw file_error(msg.str());
+  }
+  // Replacing the destination instead of writing through it (unless it's the source itself)
+  struct stat ds;
+  if (lstat(dest_file.c_str(),&ds)==0 && !S_ISDIR(ds.st_mode)) {
+    char* src_path = realpath(source_file.c_str(),NULL);
+    char* dst_path = realpath(dest_file.c_str(),NULL);
+    bool same = src_path!=NULL && dst_path!=NULL && strcmp(src_path,dst_path)==0;
+    free(src_path);
+    free(dst_path);
+    if (same) {
+      close(src_fd);
+      return;
+    }
+    unlink(dest_file.c_str());
+  }
+  int dst_fd = open(dest_file.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,(ss.st_mode & 07777) | S_IWUSR);
+  if (dst_fd<0) {
+    std::ostringstream msg;
+    msg << "Can't open " << dest_file << " to write: " << strerror(errno);
+    close(src_fd);
+    throw file_error(msg.str());
+  }
+
+  // Copying
+  if (!copy_fd(src_fd,dst_fd,ss.st_size)) {
+    std::ostringstream msg;
+    msg << "Problem copying " << source_file << " to " << dest_file << ": " << strerror(errno);
+    close(src_fd);
+    close(dst_fd);
+    throw file_error(msg.str());
+  }
+  close(src_fd);
+  close(dst_fd);
+
+}
+
+/**
+ * The place_file function puts a file at the destination using the given
+ * method.  Anything already at the destination is unlinked first, so a
+ * link left by an earlier placement is replaced rather than written
+ * through (which would change the file it points to).  If a reflink
+ * or hard link isn't possible (e.g., the files are on different
+ * filesystems), the file is copied instead.
+ *
+ * @param source_file file to be placed.
+ * @param dest_file destination.
+ * @param method how the file is placed (see copy_method).
+ */
+
+inline void place_file(const std::string source_file, const std::string dest_file, const copy_method method) {
+
+  unlink(dest_file.c_str());
+  if (method==copy_method_hardlink || method==copy_method_symlink) {
+    int rc;
+    if (method==copy_method_hardlink) {
+      rc = link(source_file.c_str(),dest_file.c_str());
+    }
+    else {
+      // Symlinks are made absolute so that they don't depend on where dest_file is
+      char* full = realpath(source_file.c_str(),NULL);
+      rc = symlink(full==NULL ? source_file.c_str() : full,dest_file.c_str());
+      free(full);
+    }
+    if (rc==0) {
+      return;
+    }
+    if (errno!=EXDEV && errno!=EPERM && errno!=EMLINK && errno!=ENOTSUP) {
+      std::ostringstream msg;
+      msg << "Can't link " << source_file << " to " << dest_file << ": " << strerror(errno);
+      throw file_error(msg.str());
+    }
   }
 
-  // Copying using streams
-  std::ifstream src(source_file.c_str(),std::ios::binary);
-  std::ofstream dst(dest_file.c_str(),std::ios::binary);
-  dst << src.rdbuf();
-  src.close();
-  dst.close();
+  // copy_file already tries a reflink first
+  copy_file(source_file,dest_file);
+
+}
+
+/**
+ * The default_clone_policy function links files which are read-only (e.g.,
+ * meshes that have been chmod-ed a-w) and copies everything else.
+ *
+ * @param path path of the source file.
+ * @return The method used to place the file.
+ */
+
+inline copy_method default_clone_policy(const std::string path) {
+  struct stat ss;
+  if (stat(path.c_str(),&ss)==0 && (ss.st_mode & (S_IWUSR | S_IWGRP | S_IWOTH))==0) {
+    return copy_method_hardlink;
+  }
+  return copy_method_copy;
+}
+
+/**
+ * The clone_tree function recursively clones a case directory.  The
+ * directories are created first and then the files are placed by several
+ * threads, each file using the method returned by the policy.  Symbolic
+ * links in the source are recreated as-is.  If a file can't be placed, the
+ * other threads stop taking files and the first error is rethrown once
+ * they have all finished.
+ *
+ * @param source_dir directory to be cloned.
+ * @param dest_dir destination directory (created if it doesn't exist).
+ * @param policy function which returns the copy_method for each source file (default is default_clone_policy).
+ * @param nthreads number of threads used to place files (default is 4).
+ */
+
+inline void clone_tree(const std::string source_dir, const std::string dest_dir, std::function<copy_method(const std::string&)> policy=default_clone_policy, const unsigned int nthreads=4) {
+
+  // Walking the tree and creating the directories
+  std::vector<std::pair<std::string,std::string> > files;
+  std::vector<std::pair<std::string,std::string> > dirs(1,std::make_pair(source_dir,dest_dir));
+  for (std::size_t d=0; d<dirs.size(); ++d) {
+    const std::string src = dirs[d].first;
+    const std::string dst = dirs[d].second;
+    struct stat ss;
+    if (stat(src.c_str(),&ss)!=0 || !S_ISDIR(ss.st_mode)) {
+      std::ostringstream msg;
+      msg << src << " is not an accessible directory.";
+      throw file_error(msg.str());
+    }
+    if (mkdir(dst.c_str(),ss.st_mode & 07777)!=0 && errno!=EEXIST) {
+      std::ostringstream msg;
+      msg << "Can't create directory " << dst << ": " << strerror(errno);
+      throw file_error(msg.str());
+    }
+    std::unique_ptr<DIR,int(*)(DIR*)> dp(opendir(src.c_str()),closedir);
+    if (!dp) {
+      std::ostringstream msg;
+      msg << "Can't open directory " << src << ": " << strerror(errno);
+      throw file_error(msg.str());
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dp.get()))!=NULL) {
+      std::string name(entry->d_name);
+      if (name=="." || name=="..") {
+        continue;
+      }
+      std::string s = src + "/" + name;
+      std::string t = dst + "/" + name;
+      struct stat es;
+      if (lstat(s.c_str(),&es)!=0) {
+        continue;
+      }
+      if (S_ISDIR(es.st_mode)) {
+        dirs.push_back(std::make_pair(s,t));
+      }
+      else if (S_ISLNK(es.st_mode)) {
+        std::vector<char> target(es.st_size+1);
+        ssize_t len = readlink(s.c_str(),target.data(),target.size());
+        if (len>=0) {
+          unlink(t.c_str());
+          if (symlink(std::string(target.data(),len).c_str(),t.c_str())!=0) {
+            std::ostringstream msg;
+            msg << "Can't create symlink " << t << ": " << strerror(errno);
+            throw file_error(msg.str());
+          }
+        }
+      }
+      else if (S_ISREG(es.st_mode)) {
+        files.push_back(std::make_pair(s,t));
+      }
+    }
+  }
+
+  // Placing the files using several threads
+  std::atomic<std::size_t> next(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex mtx;
+  auto worker = [&] () {
+    for (std::size_t i=next++; i<files.size() && !failed; i=next++) {
+      try {
+        place_file(files[i].first,files[i].second,policy(files[i].first));
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned int i=1; i<nthreads && i<files.size(); ++i) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (auto& t : threads) {
+    t.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
 
 }
 
@@ -165,7 +641,7 @@ void copy_file(const std::string source_file, const std::string dest_file) {
  * Revision date :
  */
 
-void make_dir(const std::string dirname) {
+inline void make_dir(const std::string dirname) {
 
   // Checking to see if the directory exists
   if (!accessible(dirname)) {
@@ -181,46 +657,74 @@ void make_dir(const std::string dirname) {
 }
 
 /**
- * The get_value function grabs a value from a file.  It is templated so that the
- * user can return any type.  Boost is required because lexical_cast is the best
- * way to convert any type to any other type.
- * 
- * @param inputfile the name of the file from which the value will be taken.
- * @param line_num line number to grab data from (zero-based).
- * @param pos an integer which holds the position in the string where the value is.
- * @return The value from the given position in the file.
+ * The remove_tree function removes a file or a directory and everything in
+ * it.  Symbolic links are removed, not followed.
  *
- * Author        : James Grisham
- * Date          : 07/06/2015
- * Revision date : 
+ * @param path file or directory to be removed.
  */
-template <typename T> 
-T get_value(const std::string inputfile, const unsigned int line_num, const unsigned int pos) {
 
-  // Opening file stream
-  std::ifstream infile(inputfile.c_str());
-  if (!infile.is_open()) {
-    std::cerr << "\nERROR: Can't open " << inputfile << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+inline void remove_tree(const std::string path) {
+
+  struct stat ss;
+  if (lstat(path.c_str(),&ss)!=0) {
+    return;
+  }
+
+  if (S_ISDIR(ss.st_mode)) {
+    DIR* dp = opendir(path.c_str());
+    if (dp!=NULL) {
+      struct dirent* entry;
+      while ((entry = readdir(dp))!=NULL) {
+        std::string name(entry->d_name);
+        if (name!="." && name!="..") {
+          remove_tree(path + "/" + name);
+        }
+      }
+      closedir(dp);
+    }
+    if (rmdir(path.c_str())!=0) {
+      std::ostringstream msg;
+      msg << "Can't remove directory " << path << ": " << strerror(errno);
+      throw file_error(msg.str());
+    }
+  }
+  else if (unlink(path.c_str())!=0) {
+    std::ostringstream msg;
+    msg << "Can't remove " << path << ": " << strerror(errno);
+    throw file_error(msg.str());
   }
 
+}
+
+/**
+ * The get_value function grabs a value from a stream, e.g. the output of
+ * a solver which was captured in memory (see exec_result::out).
+ *
+ * @param input stream from which the value will be taken.
+ * @param line_num line number to grab data from (zero-based).
+ * @param pos an integer which holds the position in the string where the value is.
+ * @param name name of the stream used in error messages (optional).
+ * @return The value from the given position in the stream.
+ */
+template <typename T>
+T get_value(std::istream& input, const unsigned int line_num, const unsigned int pos, const std::string name="stream") {
+
   // Reading line
   std::string line;
-  int line_counter = 0;
+  unsigned int line_counter = 0;
   bool found_line = false;
-  while(getline(infile,line)) {
+  while(getline(input,line)) {
     if (line_counter == line_num) {
       found_line = true;
       break;
     }
     line_counter++;
   }
-  
+
   if (!found_line) {
-    std::cerr << "\nERROR: Didn't find line " << line_num << " in file named " << inputfile << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    std::ostringstream msg;
+    msg << "Didn't find line " << line_num << " in " << name;
+    throw parse_error(msg.str());
   }
 
   // Splitting the string
@@ -230,19 +734,286 @@ T get_value(const std::string inputfile, const unsigned int line_num, const unsi
   std::vector<std::string> sarray(begin,end);
 
  // Checking for out-of-bounds
-  if (pos>sarray.size()) {
-    std::cerr << "\nERROR: Requested index doesn't exist." << std::endl;
+  if (pos>=sarray.size()) {
+    std::ostringstream msg;
+    msg << "Requested index " << pos << " doesn't exist on line " << line_num << " of " << name << ".";
     for (unsigned int i=0; i<sarray.size(); ++i) {
-      std::cerr << "index: " << i << " entry: " << sarray[i] << std::endl;
+      msg << "\nindex: " << i << " entry: " << sarray[i];
     }
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    throw parse_error(msg.str());
   }
 
   // Recasting using boost lexical_cast which can convert anything to anything else
-  T return_val = boost::lexical_cast<T>(sarray[pos]);
+  try {
+    return boost::lexical_cast<T>(sarray[pos]);
+  }
+  catch (const boost::bad_lexical_cast&) {
+    std::ostringstream msg;
+    msg << "Can't convert " << sarray[pos] << " (line " << line_num << ", index " << pos << " of " << name << ").";
+    throw parse_error(msg.str());
+  }
+
+}
+
+/**
+ * The get_value function grabs a value from a file.  It is templated so that the
+ * user can return any type.  Boost is required because lexical_cast is the best
+ * way to convert any type to any other type.
+ * 
+ * @param inputfile the name of the file from which the value will be taken.
+ * @param line_num line number to grab data from (zero-based).
+ * @param pos an integer which holds the position in the string where the value is.
+ * @return The value from the given position in the file.
+ *
+ * Author        : James Grisham
+ * Date          : 07/06/2015
+ * Revision date : 10/18/2026
+ */
+template <typename T> 
+T get_value(const std::string inputfile, const unsigned int line_num, const unsigned int pos) {
+
+  // Opening file stream
+  std::ifstream infile(inputfile.c_str());
+  if (!infile.is_open()) {
+    std::ostringstream msg;
+    msg << "Can't open " << inputfile;
+    throw file_error(msg.str());
+  }
+
+  return get_value<T>(infile,line_num,pos,"file named " + inputfile);
+
+}
+
+/**
+ * Reads a whole file into memory in one pass.
+ */
+inline std::string read_file(const std::string filename) {
+  int fd = open(filename.c_str(),O_RDONLY | O_CLOEXEC);
+  struct stat ss;
+  if (fd<0 || fstat(fd,&ss)!=0) {
+    std::ostringstream msg;
+    msg << "Can't open " << filename << ": " << strerror(errno);
+    if (fd>=0) {
+      close(fd);
+    }
+    throw file_error(msg.str());
+  }
+  std::string contents(ss.st_size,'\0');
+  std::size_t len = 0;
+  while (len<contents.size()) {
+    ssize_t nbytes = read(fd,&contents[len],contents.size()-len);
+    if (nbytes<0 && errno==EINTR) {
+      continue;
+    }
+    if (nbytes<=0) {
+      break;
+    }
+    len += nbytes;
+  }
+  close(fd);
+  contents.resize(len);
+  return contents;
+}
+
+/**
+ * Converts the number at p, accepting Fortran style exponents (1.0D-03).
+ * end is set to p if there's no number there.
+ */
+inline double parse_number(const char* p, const char** end) {
+  char* e;
+  double value = strtod(p,&e);
+  if (e!=p && (*e=='D' || *e=='d') && (isdigit(e[1]) || e[1]=='+' || e[1]=='-')) {
+    std::string copy(p,e-p);
+    copy += 'E';
+    const char* q = e+1;
+    while (isdigit(*q) || *q=='+' || *q=='-') {
+      copy += *q++;
+    }
+    value = strtod(copy.c_str(),NULL);
+    e = const_cast<char*>(q);
+  }
+  *end = e;
+  return value;
+}
+
+// Skips the first nlines lines of text
+inline const char* skip_lines(const char* p, const char* end, const unsigned int nlines) {
+  for (unsigned int i=0; i<nlines && p<end; ++i) {
+    const char* nl = static_cast<const char*>(memchr(p,'\n',end-p));
+    p = (nl==NULL) ? end : nl+1;
+  }
+  return p;
+}
+
+/**
+ * The read_vector function reads a whole vector of values (e.g., a
+ * gradient or sensitivities written by an adjoint solver) from a text
+ * file in one pass, instead of calling get_value once per component.
+ * Every whitespace-separated number after the skipped lines is read, in
+ * order, regardless of how they're split into lines, until n values have
+ * been read or something which isn't a number is found.
+ *
+ * @param filename name of the file.
+ * @param skip number of lines (e.g., a header) which are skipped.
+ * @param n number of values expected (0 means read until the numbers stop).
+ * @return The values.
+ */
+template <typename T>
+std::vector<T> read_vector(const std::string filename, const unsigned int skip=0, const std::size_t n=0) {
+
+  std::string contents = read_file(filename);
+  const char* end = contents.data() + contents.size();
+  const char* p = skip_lines(contents.data(),end,skip);
+
+  std::vector<T> values;
+  if (n>0) {
+    values.reserve(n);
+  }
+  while (n==0 || values.size()<n) {
+    while (p<end && isspace(*p)) {
+      ++p;
+    }
+    const char* next;
+    double value = (p<end) ? parse_number(p,&next) : 0.0;
+    if (p>=end || next==p) {
+      break;
+    }
+    values.push_back(static_cast<T>(value));
+    p = next;
+  }
+
+  if (values.size()<n) {
+    std::ostringstream msg;
+    msg << "Expected " << n << " values in " << filename << " but found " << values.size() << ".";
+    throw parse_error(msg.str());
+  }
+
+  return values;
+
+}
+
+/**
+ * The read_column function reads field pos of every line (same
+ * convention as get_value) after the skipped lines, until n values have
+ * been read or a line doesn't have a number there.  Blank lines before
+ * the first value are skipped and a blank line after it ends the column.
+ *
+ * @param filename name of the file.
+ * @param pos position of the field on each line.
+ * @param skip number of lines which are skipped.
+ * @param n number of values expected (0 means read until the column ends).
+ * @return The values.
+ */
+template <typename T>
+std::vector<T> read_column(const std::string filename, const unsigned int pos, const unsigned int skip=0, const std::size_t n=0) {
+
+  std::string contents = read_file(filename);
+  const char* end = contents.data() + contents.size();
+  const char* p = skip_lines(contents.data(),end,skip);
+
+  std::vector<T> values;
+  while (p<end && (n==0 || values.size()<n)) {
+    const char* eol = static_cast<const char*>(memchr(p,'\n',end-p));
+    if (eol==NULL) {
+      eol = end;
+    }
+
+    // Finding the field
+    const char* q = p;
+    unsigned int field = 0;
+    bool blank = true;
+    while (true) {
+      while (q<eol && isspace(*q)) {
+        ++q;
+      }
+      if (q>=eol || field==pos) {
+        break;
+      }
+      blank = false;
+      while (q<eol && !isspace(*q)) {
+        ++q;
+      }
+      ++field;
+    }
+    if (q>=eol) {
+      if (blank && values.empty()) {
+        p = (eol<end) ? eol+1 : end;
+        continue;
+      }
+      break;
+    }
+
+    const char* next;
+    double value = parse_number(q,&next);
+    if (next==q || (next<eol && !isspace(*next))) {
+      break;
+    }
+    values.push_back(static_cast<T>(value));
+    p = (eol<end) ? eol+1 : end;
+  }
+
+  if (values.size()<n) {
+    std::ostringstream msg;
+    msg << "Expected " << n << " values in field " << pos << " of " << filename << " but found " << values.size() << ".";
+    throw parse_error(msg.str());
+  }
+
+  return values;
+
+}
+
+/**
+ * The read_binary_vector function reads an array of raw values (native
+ * byte order, e.g. written with fwrite or a Fortran stream write) from a
+ * file.
+ *
+ * @param filename name of the file.
+ * @param n number of values (0 means everything after offset).
+ * @param offset number of bytes skipped at the start (e.g., a record marker).
+ * @return The values.
+ */
+template <typename T>
+std::vector<T> read_binary_vector(const std::string filename, const std::size_t n=0, const off_t offset=0) {
+
+  int fd = open(filename.c_str(),O_RDONLY | O_CLOEXEC);
+  struct stat ss;
+  if (fd<0 || fstat(fd,&ss)!=0) {
+    std::ostringstream msg;
+    msg << "Can't open " << filename << ": " << strerror(errno);
+    if (fd>=0) {
+      close(fd);
+    }
+    throw file_error(msg.str());
+  }
+
+  std::size_t available = (ss.st_size>offset) ? (ss.st_size-offset)/sizeof(T) : 0;
+  std::size_t count = (n==0) ? available : n;
+  if (count>available) {
+    close(fd);
+    std::ostringstream msg;
+    msg << "Expected " << n << " values in " << filename << " but it only holds " << available << ".";
+    throw parse_error(msg.str());
+  }
+
+  std::vector<T> values(count);
+  char* data = reinterpret_cast<char*>(values.data());
+  std::size_t len = 0;
+  while (len<count*sizeof(T)) {
+    ssize_t nbytes = pread(fd,data+len,count*sizeof(T)-len,offset+len);
+    if (nbytes<0 && errno==EINTR) {
+      continue;
+    }
+    if (nbytes<=0) {
+      std::ostringstream msg;
+      msg << "Problem reading " << filename << ": " << strerror(errno);
+      close(fd);
+      throw file_error(msg.str());
+    }
+    len += nbytes;
+  }
+  close(fd);
 
-  return return_val;
+  return values;
 
 }
 
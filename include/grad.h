@@ -19,6 +19,11 @@
 #define GRADHEADERDEF
 
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include "telemetry.h"
 
 // Function for computing the gradient using the finite difference method
 template <typename T, typename... Tn>
@@ -32,7 +37,7 @@ std::vector<T> grad_fdm(const std::vector<T>&X, const T FX, const std::vector<T>
   // Finding gradients
   for (unsigned int i=0; i<X.size(); ++i) {
     XpdX[i] += dX[i];
-    FXpdX = (*f)(XpdX,params...);
+    FXpdX = telemetry::eval(f,XpdX,params...);
     grad[i] = (FXpdX - FX)/dX[i];
     XpdX = X;
   }
@@ -41,5 +46,105 @@ std::vector<T> grad_fdm(const std::vector<T>&X, const T FX, const std::vector<T>
 
 }
 
+// Function for evaluating f at many points at once.  nworkers threads
+// take points until none are left (0 means one thread per point), so f
+// has to be safe to call from several threads, e.g. each call running
+// the solver in its own case directory.
+template <typename T, typename... Tn>
+std::vector<T> eval_points(const std::vector<std::vector<T> >& points, const unsigned int nworkers, T (*f)(const std::vector<T>&,Tn...), Tn... params) {
+
+  std::vector<T> F(points.size());
+  std::atomic<std::size_t> next(0);
+  std::exception_ptr error;
+  std::mutex mtx;
+
+  auto work = [&] () {
+    for (std::size_t i=next++; i<points.size(); i=next++) {
+      try {
+        F[i] = telemetry::eval(f,points[i],params...);
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+
+  std::size_t n = (nworkers==0 || nworkers>points.size()) ? points.size() : nworkers;
+  if (n<=1) {
+    work();
+  }
+  else {
+    std::vector<std::thread> threads;
+    for (std::size_t k=0; k<n; ++k) {
+      threads.push_back(std::thread(work));
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  return F;
+
+}
+
+// Function for computing the gradient and the Hessian using second order
+// central differences.  Because the Hessian is symmetric, only the upper
+// triangle is evaluated: f(X+-dXi) gives the gradient and the diagonal,
+// and f(X+dXi+dXj), f(X-dXi-dXj) give H_ij for i<j, so there are
+// N*(N+1) evaluations in all.  None depends on another, so they're all
+// run at once (see eval_points) and the whole Hessian takes the time of
+// one evaluation if there are enough workers.
+template <typename T, typename... Tn>
+std::vector<std::vector<T> > hess_fdm(const std::vector<T>& X, const T FX, const std::vector<T>& dX, std::vector<T>& grad, const unsigned int nworkers, T (*f)(const std::vector<T>&,Tn...), Tn... params) {
+
+  std::size_t N = X.size();
+
+  // Points: X+dXi and X-dXi, then X+dXi+dXj and X-dXi-dXj for i<j
+  std::vector<std::vector<T> > points;
+  points.reserve(N*(N+1));
+  for (std::size_t i=0; i<N; ++i) {
+    points.push_back(X);
+    points.back()[i] += dX[i];
+    points.push_back(X);
+    points.back()[i] -= dX[i];
+  }
+  for (std::size_t i=0; i<N; ++i) {
+    for (std::size_t j=i+1; j<N; ++j) {
+      points.push_back(X);
+      points.back()[i] += dX[i];
+      points.back()[j] += dX[j];
+      points.push_back(X);
+      points.back()[i] -= dX[i];
+      points.back()[j] -= dX[j];
+    }
+  }
+
+  std::vector<T> F = eval_points<T,Tn...>(points,nworkers,f,params...);
+
+  grad.resize(N);
+  std::vector<std::vector<T> > H(N,std::vector<T>(N));
+  for (std::size_t i=0; i<N; ++i) {
+    grad[i] = (F[2*i] - F[2*i+1])/(2.0*dX[i]);
+    H[i][i] = (F[2*i] - 2.0*FX + F[2*i+1])/(dX[i]*dX[i]);
+  }
+  std::size_t k = 2*N;
+  for (std::size_t i=0; i<N; ++i) {
+    for (std::size_t j=i+1; j<N; ++j) {
+      T fpp = F[k++];
+      T fmm = F[k++];
+      H[i][j] = (fpp - F[2*i] - F[2*j] + 2.0*FX - F[2*i+1] - F[2*j+1] + fmm)/(2.0*dX[i]*dX[j]);
+      H[j][i] = H[i][j];
+    }
+  }
+
+  return H;
+
+}
 
 #endif
@@ -23,6 +23,7 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include "telemetry.h"
 
 #define tau 0.381966
 
@@ -59,14 +60,14 @@ T gss(const T X0, const T Xmin, const T Xmax, const T tol, T (*f)(const T,Tn...)
   // Performing initial function evaluations
   Xl = Xmin;
   Xu = Xmax;
-  Fl = (*f)(Xl,params...);
-  Fu = (*f)(Xu,params...);
+  Fl = telemetry::eval(f,Xl,params...);
+  Fu = telemetry::eval(f,Xu,params...);
 
   // Calculating the initial X1 and X2 along with F1 and F2
   X1 = (1.0 - tau)*Xl + tau*Xu;
   X2 = tau*Xl + (1.0 - tau)*Xu;
-  F1 = (*f)(X1,params...);
-  F2 = (*f)(X2,params...);
+  F1 = telemetry::eval(f,X1,params...);
+  F2 = telemetry::eval(f,X2,params...);
 
   // Determining number of iterations required for convergence
   N = (int) (ceil(log(eps)/(log(1.0 - tau)) + 3.0));
@@ -83,7 +84,7 @@ T gss(const T X0, const T Xmin, const T Xmax, const T tol, T (*f)(const T,Tn...)
       X1 = X2;
       F1 = F2;
       X2 = tau*Xl + (1.0 - tau)*Xu;
-      F2 = (*f)(X2,params...);
+      F2 = telemetry::eval(f,X2,params...);
     }
     else {
       Xu = X2;
@@ -91,11 +92,13 @@ T gss(const T X0, const T Xmin, const T Xmax, const T tol, T (*f)(const T,Tn...)
       X2 = X1;
       F2 = F1;
       X1 = (1.0 - tau)*Xl + tau*Xu;
-      F1 = (*f)(X1,params...);
+      F1 = telemetry::eval(f,X1,params...);
     }
 
+    telemetry::iteration("gss",K,(F1<F2) ? F1 : F2,Xu-Xl);
+
 #ifdef VERBOSE
-    std::cout << "Function evaluation: " << K << " Xu = " << Xu << " Xl = " << Xl << std::endl;
+    std::cout << "Function evaluation: " << K << " Xu = " << Xu << " Xl = " << Xl << '\n';
 #endif
 
   }
@@ -103,7 +106,7 @@ T gss(const T X0, const T Xmin, const T Xmax, const T tol, T (*f)(const T,Tn...)
   // Setting the optimum X value of the design variable to be equal to the 
   // average of all the points
   Xopt = (Xl + X1 + X2 + Xu)/4.0;
-  T Fopt = (*f)(Xopt,params...);
+  T Fopt = telemetry::eval(f,Xopt,params...);
 
 #ifdef VERBOSE
   std::cout << "\nXopt = " << Xopt << " Fopt = " << Fopt << "\n" << std::endl;
@@ -0,0 +1,479 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOSTSCHEDULERHEADERDEF
+#define HOSTSCHEDULERHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "executor.h"
+
+/**
+ * The host_scheduler class spreads batches of evaluations (e.g., the
+ * perturbed points of a gradient, or the members of a population) over
+ * several hosts with different speeds.  Each host has a number of slots,
+ * and each slot has its own executor (an ssh_executor on its own
+ * connection, or a local_executor) and its own thread.
+ *
+ * The latency of an evaluation on each host is learned as the batch runs
+ * (an exponentially weighted moving average).  When a slot is free, the
+ * pending tasks are assigned in a dry run to whichever slot would finish
+ * them first, counting the time left on the busy slots.  The free slot
+ * only takes a task if the dry run gives it one, so near the end of a
+ * batch a slow host leaves the last tasks to the fast ones instead of
+ * holding up the whole batch.  Once nothing is pending, a free slot
+ * repeats a task which is expected to finish later on another host than
+ * it would on this one, and the first result to come back is used.  The
+ * other copy is then cancelled: commands it runs are killed and its
+ * stage, fetch and get_fields calls throw, and its result is thrown away.
+ *
+ * The evaluation function returns false (or throws) if it failed.  The
+ * task is then put back in the queue, and it's retried on another host if
+ * there is one which hasn't failed it.  A task which fails max_attempts
+ * times is given up (see succeeded), so one bad point can't take down the
+ * batch.  A failure is only charged to a host once the task succeeds
+ * somewhere else, and a host which is charged max_failures times in a row
+ * is dropped for the rest of the batch.
+ *
+ * Usage: host_scheduler<std::vector<double>,double> sched;
+ *        sched.add_host("cluster1",slots1);
+ *        sched.add_host("cluster2",slots2);
+ *        std::vector<double> f = sched.run(points,eval);
+ */
+
+template <typename Task, typename R>
+class host_scheduler {
+
+  public:
+
+    typedef std::function<bool(executor&, const Task&, R&)> eval_function;
+
+    /**
+     * ctor
+     *
+     * @param[in] alpha weight of the newest sample in the latency estimate.
+     * @param[in] max_failures consecutive failures after which a host is dropped.
+     * @param[in] max_attempts failed attempts after which a task is given up.
+     */
+    host_scheduler(const double alpha=0.3, const unsigned int max_failures=3, const unsigned int max_attempts=3) : alpha(alpha), max_failures(max_failures), max_attempts(max_attempts) {}
+
+    /**
+     * Method for adding a host.
+     *
+     * @param[in] name name used in messages (e.g., the target of the connection).
+     * @param[in] slots one executor per evaluation which may run on the host at once.
+     */
+    void add_host(const std::string name, const std::vector<executor*> slots) {
+      host h;
+      h.name = name;
+      h.latency = -1.0;
+      h.completed = 0;
+      h.failures = 0;
+      h.enabled = true;
+      h.slots = slots;
+      hosts.push_back(h);
+    }
+
+    /**
+     * Method for adding a host whose executor can be used from several
+     * threads at once (e.g., a local_executor).
+     *
+     * @param[in] name name used in messages.
+     * @param[in] ex executor shared by the slots.
+     * @param[in] capacity number of evaluations which may run on the host at once.
+     */
+    void add_host(const std::string name, executor& ex, const unsigned int capacity) {
+      add_host(name,std::vector<executor*>(capacity,&ex));
+    }
+
+    /**
+     * Method for running a batch of tasks.
+     *
+     * @param[in] tasks the tasks.
+     * @param[in] eval runs one task with an executor, returns false if it failed.
+     * @return The results, in the same order as the tasks (R() for tasks which failed, see succeeded).
+     */
+    std::vector<R> run(const std::vector<Task>& tasks, eval_function eval) {
+
+      this->tasks = &tasks;
+      this->eval = eval;
+      results.assign(tasks.size(),R());
+      ok.assign(tasks.size(),false);
+      states.assign(tasks.size(),task_state());
+      pending.clear();
+      for (std::size_t i=0; i<tasks.size(); ++i) {
+        pending.push_back(i);
+      }
+      ndone = 0;
+      for (auto& h : hosts) {
+        h.failures = 0;
+        h.enabled = !h.slots.empty();
+        h.busy.assign(h.slots.size(),false);
+        h.started.assign(h.slots.size(),std::chrono::steady_clock::time_point());
+        h.current.assign(h.slots.size(),-1);
+        h.cancel.assign(h.slots.size(),NULL);
+      }
+
+      // One thread per slot
+      std::vector<std::thread> threads;
+      for (std::size_t h=0; h<hosts.size(); ++h) {
+        for (std::size_t s=0; s<hosts[h].slots.size(); ++s) {
+          threads.push_back(std::thread(&host_scheduler::work,this,h,s));
+        }
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+
+      if (ndone<tasks.size()) {
+        std::cerr << "\nWARNING: Every host was dropped; " << tasks.size()-ndone << " tasks weren't evaluated." << std::endl;
+      }
+      return results;
+
+    }
+
+    /**
+     * Method for checking which tasks of the last batch were evaluated.
+     *
+     * @return true for each task which has a result, in the same order as the tasks.
+     */
+    const std::vector<bool>& succeeded() const {
+      return ok;
+    }
+
+    /**
+     * Method for getting the latency estimate of a host.
+     *
+     * @return Seconds per evaluation (negative if nothing has finished on the host).
+     */
+    double latency(const std::string name) const {
+      for (auto& h : hosts) {
+        if (h.name==name) {
+          return h.latency;
+        }
+      }
+      return -1.0;
+    }
+
+    /**
+     * Method for printing how many tasks each host did and how fast.
+     */
+    void report(std::ostream& out=std::cout) const {
+      for (auto& h : hosts) {
+        out << h.name << ": " << h.completed << " tasks, " << h.latency << " s each, " << h.slots.size() << " slots" << (h.enabled ? "" : " (dropped)") << '\n';
+      }
+    }
+
+  private:
+
+    typedef std::chrono::steady_clock clock;
+
+    // Executor of a slot whose evaluation can be cancelled when another copy of the task finishes first
+    class cancellable_executor : public executor {
+      public:
+        cancellable_executor(executor& ex, const std::atomic<bool>& cancelled) : ex(ex), cancelled(cancelled) {}
+        void stage(const std::string local_file, const std::string dest_dir) {
+          check();
+          ex.stage(local_file,dest_dir);
+        }
+        exec_result run(const std::string cmd, const exec_options opts=exec_options()) {
+          check();
+          exec_options o = opts;
+          if (o.cancel==NULL) {
+            o.cancel = &cancelled;
+          }
+          return ex.run(cmd,o);
+        }
+        void fetch(const std::string file, const std::string local_file) {
+          check();
+          ex.fetch(file,local_file);
+        }
+        std::vector<std::string> get_fields(const std::vector<remote_value>& values) {
+          check();
+          return ex.get_fields(values);
+        }
+      private:
+        executor& ex;
+        const std::atomic<bool>& cancelled;
+        void check() const {
+          if (cancelled) {
+            throw cppopt_error("Evaluation cancelled; another copy finished first.");
+          }
+        }
+    };
+
+    struct host {
+      std::string name;
+      std::vector<executor*> slots;
+      std::vector<bool> busy;
+      std::vector<clock::time_point> started;
+      std::vector<long> current;
+      std::vector<std::atomic<bool>*> cancel;
+      double latency;
+      unsigned long completed;
+      unsigned int failures;
+      bool enabled;
+    };
+
+    struct task_state {
+      bool done;
+      unsigned int copies;
+      unsigned int attempts;
+      std::vector<std::size_t> failed_on;
+      task_state() : done(false), copies(0), attempts(0) {}
+    };
+
+    double alpha;
+    unsigned int max_failures;
+    unsigned int max_attempts;
+    std::vector<host> hosts;
+    const std::vector<Task>* tasks;
+    eval_function eval;
+    std::vector<R> results;
+    std::vector<bool> ok;
+    std::vector<task_state> states;
+    std::deque<std::size_t> pending;
+    std::size_t ndone;
+    std::mutex mtx;
+    std::condition_variable changed;
+
+    // Seconds until a slot is expected to be free
+    double time_left(const host& h, const std::size_t s, const clock::time_point now) const {
+      if (!h.busy[s] || h.latency<0.0) {
+        return 0.0;
+      }
+      double left = h.latency - std::chrono::duration<double>(now-h.started[s]).count();
+      return (left>0.0) ? left : 0.0;
+    }
+
+    // Dry run of the pending tasks over all the slots: does slot s of host hi get one?
+    bool should_take(const std::size_t hi, const std::size_t s, const clock::time_point now) const {
+      if (hosts[hi].latency<0.0) {
+        return true;
+      }
+      std::vector<std::vector<double> > free_at(hosts.size());
+      for (std::size_t g=0; g<hosts.size(); ++g) {
+        if (!hosts[g].enabled) {
+          continue;
+        }
+        for (std::size_t k=0; k<hosts[g].slots.size(); ++k) {
+          free_at[g].push_back(time_left(hosts[g],k,now));
+        }
+      }
+      for (std::size_t n=0; n<pending.size(); ++n) {
+        std::size_t best_g = 0, best_k = 0;
+        double best = -1.0;
+        for (std::size_t g=0; g<hosts.size(); ++g) {
+          // Hosts which haven't finished anything yet are left out of the dry run
+          if (!hosts[g].enabled || hosts[g].latency<0.0) {
+            continue;
+          }
+          for (std::size_t k=0; k<free_at[g].size(); ++k) {
+            double finish = free_at[g][k] + hosts[g].latency;
+            // Ties go to the slot which is asking
+            if (best<0.0 || finish<best || (finish==best && g==hi && k==s)) {
+              best = finish;
+              best_g = g;
+              best_k = k;
+            }
+          }
+        }
+        if (best_g==hi && best_k==s) {
+          return true;
+        }
+        free_at[best_g][best_k] = best;
+      }
+      return false;
+    }
+
+    // A task which failed on host hi is left to other hosts, unless it failed on all of them
+    bool can_take(const std::size_t i, const std::size_t hi) const {
+      const std::vector<std::size_t>& f = states[i].failed_on;
+      if (std::find(f.begin(),f.end(),hi)==f.end()) {
+        return true;
+      }
+      for (std::size_t g=0; g<hosts.size(); ++g) {
+        if (hosts[g].enabled && std::find(f.begin(),f.end(),g)==f.end()) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Counts a failure against a host, dropping it after max_failures in a row
+    void charge(host& h) {
+      h.failures++;
+      if (h.failures>=max_failures && h.enabled) {
+        std::cerr << "\nWARNING: Dropping host " << h.name << " after " << h.failures << " failures in a row." << std::endl;
+        h.enabled = false;
+      }
+    }
+
+    // Picks a task which is running on another host and is expected to finish later there than it would here
+    long straggler(const std::size_t hi, const clock::time_point now) const {
+      if (hosts[hi].latency<0.0) {
+        return -1;
+      }
+      long t = -1;
+      double latest = hosts[hi].latency;
+      for (std::size_t g=0; g<hosts.size(); ++g) {
+        if (g==hi) {
+          continue;
+        }
+        for (std::size_t k=0; k<hosts[g].slots.size(); ++k) {
+          long i = hosts[g].current[k];
+          if (!hosts[g].busy[k] || states[i].done || states[i].copies>1 || !can_take(i,hi)) {
+            continue;
+          }
+          // Without an estimate, a task is assumed to need as long again as it has already run
+          double elapsed = std::chrono::duration<double>(now-hosts[g].started[k]).count();
+          double left = (hosts[g].latency<0.0) ? elapsed : hosts[g].latency - elapsed;
+          if (left>latest) {
+            latest = left;
+            t = i;
+          }
+        }
+      }
+      return t;
+    }
+
+    void work(const std::size_t hi, const std::size_t s) {
+
+      host& h = hosts[hi];
+      std::atomic<bool> cancelled(false);
+      cancellable_executor ex(*h.slots[s],cancelled);
+      std::unique_lock<std::mutex> lock(mtx);
+      h.cancel[s] = &cancelled;
+
+      while (ndone<tasks->size() && h.enabled) {
+
+        // Choosing a task
+        clock::time_point now = clock::now();
+        long t = -1;
+        std::deque<std::size_t>::iterator next = pending.begin();
+        while (next!=pending.end() && !can_take(*next,hi)) {
+          ++next;
+        }
+        if (next!=pending.end() && should_take(hi,s,now)) {
+          t = static_cast<long>(*next);
+          pending.erase(next);
+        }
+        else if (pending.empty()) {
+          t = straggler(hi,now);
+        }
+        if (t<0) {
+          changed.wait_for(lock,std::chrono::milliseconds(50));
+          continue;
+        }
+
+        // Running it without the lock
+        std::size_t i = static_cast<std::size_t>(t);
+        states[i].copies++;
+        cancelled = false;
+        h.busy[s] = true;
+        h.started[s] = now;
+        h.current[s] = t;
+        lock.unlock();
+        R r;
+        bool good;
+        try {
+          good = eval(ex,(*tasks)[i],r);
+        }
+        catch (const std::exception& e) {
+          if (!cancelled) {
+            std::cerr << "\nWARNING: Evaluation on " << h.name << " failed: " << e.what() << std::endl;
+          }
+          good = false;
+        }
+        catch (...) {
+          if (!cancelled) {
+            std::cerr << "\nWARNING: Evaluation on " << h.name << " failed with an unknown exception." << std::endl;
+          }
+          good = false;
+        }
+        lock.lock();
+        double elapsed = std::chrono::duration<double>(clock::now()-now).count();
+        h.busy[s] = false;
+        states[i].copies--;
+
+        if (cancelled) {
+          // Another copy finished first, so this one says nothing about the host
+        }
+        else if (good) {
+          h.latency = (h.latency<0.0) ? elapsed : alpha*elapsed + (1.0-alpha)*h.latency;
+          h.completed++;
+          h.failures = 0;
+          if (!states[i].done) {
+            states[i].done = true;
+            results[i] = r;
+            ok[i] = true;
+            ndone++;
+            // The task is fine, so the hosts which failed it are charged
+            for (auto g : states[i].failed_on) {
+              if (g!=hi) {
+                charge(hosts[g]);
+              }
+            }
+            // Cancelling the other copies of the task
+            for (auto& g : hosts) {
+              for (std::size_t k=0; k<g.slots.size(); ++k) {
+                if (g.busy[k] && g.current[k]==t && g.cancel[k]!=NULL) {
+                  *g.cancel[k] = true;
+                }
+              }
+            }
+          }
+        }
+        else if (!states[i].done) {
+          task_state& st = states[i];
+          if (std::find(st.failed_on.begin(),st.failed_on.end(),hi)==st.failed_on.end()) {
+            st.failed_on.push_back(hi);
+          }
+          // Unless another copy is still running, giving the task up after max_attempts or putting it back
+          st.attempts++;
+          if (st.copies==0 && st.attempts>=max_attempts) {
+            std::cerr << "\nWARNING: Task " << i << " failed " << st.attempts << " times; giving up on it." << std::endl;
+            st.done = true;
+            ndone++;
+          }
+          else if (st.copies==0) {
+            pending.push_front(i);
+          }
+        }
+        changed.notify_all();
+
+      }
+
+      h.cancel[s] = NULL;
+      changed.notify_all();
+
+    }
+
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MD5HEADERDEF
+#define MD5HEADERDEF
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * The md5 class computes MD5 digests (RFC 1321).  It's only used to
+ * compare local files with remote files through md5sum, which is available
+ * on every cluster we use, so it doesn't need to be cryptographically
+ * strong.
+ *
+ * Usage: md5 h; h.update(data,len); std::string hex = h.hexdigest();
+ */
+
+class md5 {
+
+  public:
+
+    md5() : length(0), buffered(0) {
+      state[0] = 0x67452301;
+      state[1] = 0xefcdab89;
+      state[2] = 0x98badcfe;
+      state[3] = 0x10325476;
+    }
+
+    /**
+     * Method for adding data to the digest.
+     */
+    void update(const char* data, std::size_t len) {
+      length += len;
+      if (buffered>0) {
+        std::size_t n = (len<64-buffered) ? len : 64-buffered;
+        memcpy(buffer+buffered,data,n);
+        buffered += n;
+        data += n;
+        len -= n;
+        if (buffered<64) {
+          return;
+        }
+        transform(buffer);
+        buffered = 0;
+      }
+      while (len>=64) {
+        transform(reinterpret_cast<const unsigned char*>(data));
+        data += 64;
+        len -= 64;
+      }
+      memcpy(buffer,data,len);
+      buffered = len;
+    }
+
+    /**
+     * Method for finishing the digest.
+     *
+     * @return The digest as 32 lowercase hex characters (same as md5sum).
+     */
+    std::string hexdigest() {
+      uint64_t bits = length*8;
+      unsigned char pad[72] = {0x80};
+      std::size_t npad = (buffered<56) ? 56-buffered : 120-buffered;
+      update(reinterpret_cast<const char*>(pad),npad);
+      unsigned char len_bytes[8];
+      for (int i=0; i<8; ++i) {
+        len_bytes[i] = static_cast<unsigned char>(bits >> (8*i));
+      }
+      update(reinterpret_cast<const char*>(len_bytes),8);
+      const char hex[] = "0123456789abcdef";
+      std::string out;
+      for (int i=0; i<4; ++i) {
+        for (int j=0; j<4; ++j) {
+          unsigned char b = static_cast<unsigned char>(state[i] >> (8*j));
+          out += hex[b >> 4];
+          out += hex[b & 0xf];
+        }
+      }
+      return out;
+    }
+
+  private:
+
+    uint32_t state[4];
+    uint64_t length;
+    unsigned char buffer[64];
+    std::size_t buffered;
+
+    static uint32_t rotl(const uint32_t x, const int c) {
+      return (x << c) | (x >> (32-c));
+    }
+
+    void transform(const unsigned char* block) {
+
+      static const uint32_t K[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391 };
+      static const int R[64] = {
+        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+        5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21 };
+
+      uint32_t M[16];
+      for (int i=0; i<16; ++i) {
+        M[i] = block[4*i] | (block[4*i+1] << 8) | (block[4*i+2] << 16) | (static_cast<uint32_t>(block[4*i+3]) << 24);
+      }
+
+      uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+      for (int i=0; i<64; ++i) {
+        uint32_t f;
+        int g;
+        if (i<16) {
+          f = (b & c) | (~b & d);
+          g = i;
+        }
+        else if (i<32) {
+          f = (d & b) | (~d & c);
+          g = (5*i + 1) % 16;
+        }
+        else if (i<48) {
+          f = b ^ c ^ d;
+          g = (3*i + 5) % 16;
+        }
+        else {
+          f = c ^ (b | ~d);
+          g = (7*i) % 16;
+        }
+        uint32_t tmp = d;
+        d = c;
+        c = b;
+        b = b + rotl(a + f + K[i] + M[g],R[i]);
+        a = tmp;
+      }
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+
+    }
+
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NEWTONHEADERDEF
+#define NEWTONHEADERDEF
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "grad.h"
+
+/**
+ * Solves (H + mu*I) p = -g with a Cholesky factorization.  Returns false
+ * if H + mu*I isn't positive definite.
+ */
+template <typename T>
+bool newton_step(const std::vector<std::vector<T> >& H, const std::vector<T>& g, const T mu, std::vector<T>& p) {
+
+  std::size_t N = g.size();
+  std::vector<std::vector<T> > L(N,std::vector<T>(N,0.0));
+  for (std::size_t j=0; j<N; ++j) {
+    T d = H[j][j] + mu;
+    for (std::size_t k=0; k<j; ++k) {
+      d -= L[j][k]*L[j][k];
+    }
+    if (!(d>0.0)) {
+      return false;
+    }
+    L[j][j] = sqrt(d);
+    for (std::size_t i=j+1; i<N; ++i) {
+      T s = H[i][j];
+      for (std::size_t k=0; k<j; ++k) {
+        s -= L[i][k]*L[j][k];
+      }
+      L[i][j] = s/L[j][j];
+    }
+  }
+
+  // Forward and back substitution
+  p.assign(N,0.0);
+  for (std::size_t i=0; i<N; ++i) {
+    T s = -g[i];
+    for (std::size_t k=0; k<i; ++k) {
+      s -= L[i][k]*p[k];
+    }
+    p[i] = s/L[i][i];
+  }
+  for (std::size_t i=N; i-->0; ) {
+    T s = p[i];
+    for (std::size_t k=i+1; k<N; ++k) {
+      s -= L[k][i]*p[k];
+    }
+    p[i] = s/L[i][i];
+  }
+
+  return true;
+
+}
+
+/**
+ * This header contains a templated function which is an implementation
+ * of a damped Newton method for smooth problems with few variables.
+ * Each iteration needs one round of evaluations for the gradient and the
+ * Hessian (see hess_fdm) and one round for the step, and all of the
+ * evaluations in a round run at once on nworkers threads, so the number
+ * of sequential rounds is about twice the number of iterations.
+ *
+ * If the Hessian isn't positive definite, mu*I is added to it until it is
+ * (a Levenberg-Marquardt style shift, which turns the step toward
+ * steepest descent).  The step is then tried at lengths 1, 1/2, 1/4 and
+ * 1/8 together, and the longest one which decreases f enough is taken.
+ * If none does, mu is increased and the step is tried again.  Trial
+ * points where f isn't finite are never taken, and the iteration stops if
+ * f, the gradient or the Hessian at the current point isn't finite.
+ *
+ * f has to be safe to call from several threads (see eval_points).
+ *
+ * @param[in] X0 initial guess.
+ * @param[in] tol iteration stops when every component of the gradient is smaller than tol.
+ * @param[in] max_iter max number of iterations.
+ * @param[in] nworkers number of evaluations which run at once (0 means as many as are needed).
+ * @param[in] (*f)(const std::vector<T>&,Tn...) function pointer for the objective function.
+ * @param[in] params parameter pack passed to *f.
+ * @return The optimum.
+ */
+
+template <typename T, typename... Tn>
+std::vector<T> newton(const std::vector<T>& X0, const T tol, const unsigned int max_iter, const unsigned int nworkers, T (*f)(const std::vector<T>&,Tn...), Tn... params) {
+
+  const unsigned int ntrials = 4;
+  const unsigned int max_damping = 100;
+  std::size_t N = X0.size();
+  std::vector<T> X = X0;
+  std::vector<T> dX(N);
+  std::vector<T> g, p;
+  T F = telemetry::eval(f,X,params...);
+  T mu = 0.0;
+
+  for (unsigned int iter=0; iter<max_iter; ++iter) {
+
+    // Step size which balances truncation and round-off error for a second derivative
+    for (std::size_t i=0; i<N; ++i) {
+      dX[i] = 1.0e-4*std::max<T>(fabs(X[i]),1.0);
+    }
+    std::vector<std::vector<T> > H;
+    {
+      telemetry::scope timer(telemetry::phase_gradient,"hessian");
+      H = hess_fdm<T,Tn...>(X,F,dX,g,nworkers,f,params...);
+    }
+    telemetry::count(telemetry::counter_gradients);
+
+    T gmax = 0.0;
+    T hmax = 0.0;
+    bool finite = std::isfinite(F);
+    for (std::size_t i=0; i<N; ++i) {
+      gmax = std::max<T>(gmax,fabs(g[i]));
+      hmax = std::max<T>(hmax,fabs(H[i][i]));
+      finite = finite && std::isfinite(g[i]);
+      for (std::size_t j=0; j<N; ++j) {
+        finite = finite && std::isfinite(H[i][j]);
+      }
+    }
+    if (!finite) {
+      std::cout << "Newton stopped: f, the gradient or the Hessian isn't finite." << std::endl;
+      break;
+    }
+    if (gmax<tol) {
+      std::cout << "Newton complete." << std::endl;
+      break;
+    }
+
+    // Trying the step, with more damping each time it fails
+    bool moved = false;
+    bool singular = false;
+    for (unsigned int attempt=0; attempt<30 && !moved && !singular; ++attempt) {
+
+      unsigned int ndamping = 0;
+      while (!newton_step(H,g,mu,p)) {
+        if (++ndamping>max_damping) {
+          singular = true;
+          break;
+        }
+        mu = std::max<T>(4.0*mu,1.0e-3*std::max<T>(hmax,1.0));
+      }
+      if (singular) {
+        break;
+      }
+      T slope = 0.0;
+      for (std::size_t i=0; i<N; ++i) {
+        slope += g[i]*p[i];
+      }
+
+      std::vector<std::vector<T> > trials(ntrials,X);
+      T alpha = 1.0;
+      for (unsigned int k=0; k<ntrials; ++k, alpha*=0.5) {
+        for (std::size_t i=0; i<N; ++i) {
+          trials[k][i] += alpha*p[i];
+        }
+      }
+      std::vector<T> Ft;
+      {
+        telemetry::scope search(telemetry::phase_line_search);
+        Ft = eval_points<T,Tn...>(trials,nworkers,f,params...);
+      }
+
+      // Longest step which satisfies the sufficient decrease condition
+      alpha = 1.0;
+      for (unsigned int k=0; k<ntrials; ++k, alpha*=0.5) {
+        if (std::isfinite(Ft[k]) && Ft[k]<=F + 1.0e-4*alpha*slope) {
+          X = trials[k];
+          F = Ft[k];
+          moved = true;
+          telemetry::iteration("newton",iter,F,alpha);
+          break;
+        }
+      }
+
+      if (moved) {
+        mu = (alpha==1.0) ? 0.25*mu : mu;
+      }
+      else {
+        mu = std::max<T>(4.0*mu,1.0e-3*std::max<T>(hmax,1.0));
+      }
+
+    }
+
+#ifdef VERBOSE
+    std::cout << "iteration: " << iter << " f = " << F << " x = ";
+    for (auto val : X) {
+      std::cout << val << " ";
+    }
+    std::cout << '\n';
+#endif
+
+    if (singular) {
+      std::cout << "Newton stopped: the damped Hessian isn't positive definite." << std::endl;
+      break;
+    }
+    if (!moved) {
+      std::cout << "Newton stopped: no step decreases f." << std::endl;
+      break;
+    }
+
+  }
+
+  return X;
+
+}
+
+#endif
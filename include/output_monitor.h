@@ -0,0 +1,478 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUTMONITORHEADERDEF
+#define OUTPUTMONITORHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <map>
+#include <iterator>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "boost/lexical_cast.hpp"
+#include "errors.h"
+
+/**
+ * Selects values from a file in the same way as get_value.  line_num is
+ * the zero-based line number and pos is the position of the
+ * whitespace-separated field in that line.  If every_line is true, the
+ * field is also taken from every line after line_num, which is what is
+ * wanted for residual or monitor histories that grow as the solver runs.
+ * Lines which don't have a numeric field at pos are skipped.
+ */
+struct value_selector {
+  unsigned int line_num;
+  unsigned int pos;
+  bool every_line;
+};
+
+/**
+ * The output_monitor class follows files that are being written by an
+ * external solver.  New output is parsed incrementally as it is appended,
+ * the selected values are passed to a user supplied convergence predicate
+ * and, once the predicate returns true, the solver process can be sent a
+ * signal so that it stops early.
+ *
+ * All of the watches are serviced by a single event loop thread.  inotify
+ * is used to wake the loop when a watched file changes, and every file is
+ * also checked each poll interval.  The polling is what makes it work on
+ * network filesystems (where inotify doesn't see writes from other hosts)
+ * or when inotify isn't available.
+ *
+ * The predicate and callback are called from the event loop thread, with
+ * the monitor unlocked, so they may use the other methods (but not wait or
+ * stop).  An exception thrown by either is reported and the watch is
+ * treated as not converged.
+ */
+
+class output_monitor {
+
+  public:
+
+    typedef std::function<bool(const std::vector<double>&)> predicate;
+    typedef std::function<void(const std::string&, const std::vector<double>&)> callback;
+
+    /**
+     * ctor which starts the event loop thread.
+     *
+     * @param[in] poll_ms interval at which all files are checked, in milliseconds.
+     */
+    explicit output_monitor(const int poll_ms=250) : poll_interval(poll_ms), next_id(0), running(true) {
+      if (pipe(wake_fd)!=0) {
+        throw file_error("Can't create pipe for output_monitor.");
+      }
+      fcntl(wake_fd[0],F_SETFL,O_NONBLOCK);
+      fcntl(wake_fd[1],F_SETFL,O_NONBLOCK);
+      inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      loop_thread = std::thread(&output_monitor::event_loop,this);
+    }
+
+    /**
+     * dtor which stops the event loop.
+     */
+    ~output_monitor() {
+      stop();
+      close(wake_fd[0]);
+      close(wake_fd[1]);
+      if (inotify_fd>=0) {
+        close(inotify_fd);
+      }
+    }
+
+    /**
+     * Method for adding a file to the monitor.  The file doesn't have to
+     * exist yet.
+     *
+     * @param[in] filename name of the file written by the solver.
+     * @param[in] sel selects which values are taken from the file.
+     * @param[in] converged predicate which is given the history of selected values.
+     * @param[in] pid process which is signaled once converged is true (0 for none).
+     * @param[in] sig signal sent to pid (default is SIGTERM).
+     * @param[in] on_converged called with the filename and history once converged is true (optional).
+     * @return id of the watch.
+     */
+    int add_watch(const std::string filename, const value_selector sel, predicate converged, const pid_t pid=0, const int sig=SIGTERM, callback on_converged=callback()) {
+      std::lock_guard<std::mutex> lock(mtx);
+      int id = next_id++;
+      watch& w = watches[id];
+      w.filename = filename;
+      w.sel = sel;
+      w.converged_fn = converged;
+      w.on_converged = on_converged;
+      w.pid = pid;
+      w.sig = sig;
+      w.offset = 0;
+      w.ino = 0;
+      w.line_counter = 0;
+      w.converged = false;
+
+      // Watching the directory so that files which don't exist yet are seen
+      if (inotify_fd>=0) {
+        std::size_t slash = filename.rfind('/');
+        std::string dir = (slash==std::string::npos) ? "." : filename.substr(0,slash+1);
+        w.basename = (slash==std::string::npos) ? filename : filename.substr(slash+1);
+        w.wd = inotify_add_watch(inotify_fd,dir.c_str(),IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE);
+      }
+      else {
+        w.wd = -1;
+      }
+      wake();
+      return id;
+    }
+
+    /**
+     * Method for removing a watch.  Any thread waiting on it is released.
+     *
+     * @param[in] id id returned by add_watch.
+     */
+    void remove_watch(const int id) {
+      std::lock_guard<std::mutex> lock(mtx);
+      std::map<int,watch>::iterator it = watches.find(id);
+      if (it!=watches.end()) {
+
+        // Watches on files in the same directory share an inotify watch
+        int wd = it->second.wd;
+        watches.erase(it);
+        bool shared = false;
+        for (auto& kv : watches) {
+          shared = shared || kv.second.wd==wd;
+        }
+        if (wd>=0 && !shared) {
+          inotify_rm_watch(inotify_fd,wd);
+        }
+
+      }
+      done.notify_all();
+    }
+
+    /**
+     * Method for blocking until a watch has converged or has been removed.
+     *
+     * @param[in] id id returned by add_watch.
+     * @param[in] timeout_ms maximum time to wait, in milliseconds (negative waits forever).
+     * @return true if the watch converged.
+     */
+    bool wait(const int id, const long timeout_ms=-1) {
+      std::unique_lock<std::mutex> lock(mtx);
+      auto finished = [this,id] () {
+        std::map<int,watch>::const_iterator it = watches.find(id);
+        return it==watches.end() || it->second.converged || !running;
+      };
+      if (timeout_ms<0) {
+        done.wait(lock,finished);
+      }
+      else {
+        done.wait_for(lock,std::chrono::milliseconds(timeout_ms),finished);
+      }
+      std::map<int,watch>::const_iterator it = watches.find(id);
+      return it!=watches.end() && it->second.converged;
+    }
+
+    /**
+     * Method for getting the values which have been selected so far.
+     *
+     * @param[in] id id returned by add_watch.
+     * @return copy of the value history.
+     */
+    std::vector<double> history(const int id) const {
+      std::lock_guard<std::mutex> lock(mtx);
+      std::map<int,watch>::const_iterator it = watches.find(id);
+      return (it==watches.end()) ? std::vector<double>() : it->second.values;
+    }
+
+    bool converged(const int id) const {
+      std::lock_guard<std::mutex> lock(mtx);
+      std::map<int,watch>::const_iterator it = watches.find(id);
+      return it!=watches.end() && it->second.converged;
+    }
+
+    /**
+     * Method for stopping the event loop.  Called by the dtor.
+     */
+    void stop() {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!running) {
+          return;
+        }
+        running = false;
+      }
+      wake();
+      loop_thread.join();
+      done.notify_all();
+    }
+
+  private:
+
+    struct watch {
+      std::string filename;
+      std::string basename;
+      value_selector sel;
+      predicate converged_fn;
+      callback on_converged;
+      pid_t pid;
+      int sig;
+      int wd;
+      off_t offset;
+      ino_t ino;
+      unsigned int line_counter;
+      std::string partial;
+      std::vector<double> values;
+      bool converged;
+    };
+
+    int poll_interval;
+    int next_id;
+    bool running;
+    int inotify_fd;
+    int wake_fd[2];
+    std::map<int,watch> watches;
+    mutable std::mutex mtx;
+    std::condition_variable done;
+    std::thread loop_thread;
+
+    void wake() {
+      char c = 0;
+      ssize_t rc = write(wake_fd[1],&c,1);
+      (void) rc;
+    }
+
+    // Parses one complete line, returns true if the predicate was evaluated
+    bool parse_line(watch& w, const std::string& line) {
+      unsigned int lnum = w.line_counter++;
+      if (lnum<w.sel.line_num || (!w.sel.every_line && lnum!=w.sel.line_num)) {
+        return false;
+      }
+      std::stringstream ss(line);
+      std::istream_iterator<std::string> begin(ss);
+      std::istream_iterator<std::string> end;
+      std::vector<std::string> sarray(begin,end);
+      if (w.sel.pos>=sarray.size()) {
+        return false;
+      }
+      try {
+        w.values.push_back(boost::lexical_cast<double>(sarray[w.sel.pos]));
+      }
+      catch (boost::bad_lexical_cast&) {
+        return false;
+      }
+      return true;
+    }
+
+    // A watch with new values whose predicate still has to be called
+    struct check {
+      int id;
+      predicate converged_fn;
+      std::vector<double> values;
+    };
+
+    // Reads whatever has been appended to the file since the last update,
+    // returns true if there are new values
+    bool update(watch& w) {
+
+      if (w.converged) {
+        return false;
+      }
+
+      int fd = open(w.filename.c_str(),O_RDONLY | O_CLOEXEC);
+      if (fd<0) {
+        return false;
+      }
+
+      // Starting over if the file was truncated or replaced (a new file can
+      // already be longer than the old one, so the inode is compared too)
+      struct stat ss;
+      if (fstat(fd,&ss)==0) {
+        if (ss.st_size<w.offset || (w.ino!=0 && ss.st_ino!=w.ino)) {
+          w.offset = 0;
+          w.line_counter = 0;
+          w.partial.clear();
+          w.values.clear();
+        }
+        w.ino = ss.st_ino;
+      }
+
+      char buffer[65536];
+      ssize_t nbytes;
+      bool new_values = false;
+      while ((nbytes = pread(fd,buffer,sizeof(buffer),w.offset))>0) {
+        w.offset += nbytes;
+        const char* p = buffer;
+        const char* bend = buffer + nbytes;
+        while (p<bend) {
+          const char* nl = static_cast<const char*>(memchr(p,'\n',bend-p));
+          if (nl==NULL) {
+            w.partial.append(p,bend);
+            break;
+          }
+          w.partial.append(p,nl);
+          new_values = parse_line(w,w.partial) || new_values;
+          w.partial.clear();
+          p = nl + 1;
+        }
+      }
+      close(fd);
+
+      return new_values;
+
+    }
+
+    // Calls the predicates without the lock, then marks the watches which converged
+    void check_convergence(std::vector<check>& checks) {
+
+      for (auto& c : checks) {
+
+        bool converged = false;
+        try {
+          converged = c.converged_fn(c.values);
+        }
+        catch (std::exception& e) {
+          std::cerr << "WARNING: convergence predicate threw in output_monitor: " << e.what() << std::endl;
+        }
+        catch (...) {
+          std::cerr << "WARNING: convergence predicate threw in output_monitor." << std::endl;
+        }
+        if (!converged) {
+          continue;
+        }
+
+        callback on_converged;
+        std::string filename;
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          std::map<int,watch>::iterator it = watches.find(c.id);
+          if (it==watches.end() || it->second.converged) {
+            continue;
+          }
+          watch& w = it->second;
+          w.converged = true;
+          if (w.pid>0) {
+            kill(w.pid,w.sig);
+          }
+          on_converged = w.on_converged;
+          filename = w.filename;
+        }
+        done.notify_all();
+
+        if (on_converged) {
+          try {
+            on_converged(filename,c.values);
+          }
+          catch (std::exception& e) {
+            std::cerr << "WARNING: convergence callback threw in output_monitor: " << e.what() << std::endl;
+          }
+          catch (...) {
+            std::cerr << "WARNING: convergence callback threw in output_monitor." << std::endl;
+          }
+        }
+
+      }
+
+    }
+
+    void event_loop() {
+
+      std::vector<struct pollfd> fds(2);
+      fds[0].fd = wake_fd[0];
+      fds[0].events = POLLIN;
+      fds[1].fd = inotify_fd;
+      fds[1].events = POLLIN;
+      nfds_t nfds = (inotify_fd>=0) ? 2 : 1;
+      char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+      std::chrono::steady_clock::time_point last_scan = std::chrono::steady_clock::now();
+
+      while (true) {
+
+        int rc = poll(fds.data(),nfds,poll_interval);
+        if (rc<0 && errno!=EINTR) {
+          // Can't throw from the event loop thread, so falling back to checking every poll interval
+          std::cerr << "WARNING: poll failed in output_monitor: " << strerror(errno) << std::endl;
+          std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval));
+        }
+
+        // Draining the wake-up pipe
+        if (rc>0 && (fds[0].revents & POLLIN)) {
+          while (read(wake_fd[0],buffer,sizeof(buffer))>0) {}
+        }
+
+        std::vector<check> checks;
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!running) {
+          break;
+        }
+        auto changed = [&checks] (const int id, watch& w) {
+          checks.push_back(check());
+          checks.back().id = id;
+          checks.back().converged_fn = w.converged_fn;
+          checks.back().values = w.values;
+        };
+
+        if (rc>0 && nfds==2 && (fds[1].revents & POLLIN)) {
+
+          // Only updating the watches whose files changed
+          ssize_t len;
+          while ((len = read(inotify_fd,buffer,sizeof(buffer)))>0) {
+            for (char* p=buffer; p<buffer+len; ) {
+              const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(p);
+              for (auto& kv : watches) {
+                if (kv.second.wd==ev->wd && ev->len>0 && kv.second.basename==ev->name && update(kv.second)) {
+                  changed(kv.first,kv.second);
+                }
+              }
+              p += sizeof(struct inotify_event) + ev->len;
+            }
+          }
+
+        }
+
+        // Checking every file once per poll interval, or when woken up
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (rc==0 || (fds[0].revents & POLLIN) || now-last_scan>=std::chrono::milliseconds(poll_interval)) {
+          for (auto& kv : watches) {
+            if (update(kv.second)) {
+              changed(kv.first,kv.second);
+            }
+          }
+          last_scan = now;
+        }
+
+        lock.unlock();
+        check_convergence(checks);
+
+      }
+
+    }
+
+};
+
+#endif
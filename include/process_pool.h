@@ -0,0 +1,537 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROCESSPOOLHEADERDEF
+#define PROCESSPOOLHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+#include <signal.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "exec_types.h"
+
+extern char** environ;
+
+/**
+ * How the jobs of a process_pool are pinned to cpus.
+ *
+ *   pin_none  : jobs run wherever the scheduler puts them.
+ *   pin_cores : each slot gets its own cores_per_job cpus.
+ *   pin_numa  : slots are spread round robin over the NUMA nodes, and each
+ *               job may run on any cpu of its node.
+ */
+enum pin_policy {pin_none, pin_cores, pin_numa};
+
+/**
+ * Options for one job of a process_pool.
+ *
+ *   work_dir    : directory the command runs in (empty means the current one).
+ *   stdout_file : file stdout is written to (empty means /dev/null, relative to work_dir).
+ *   stderr_file : file stderr is written to (empty means /dev/null, relative to work_dir).
+ *   timeout_ms  : time after which the job gets SIGTERM (negative waits forever).
+ *   grace_ms    : time between SIGTERM and SIGKILL.
+ *   cpus        : cpus the job is pinned to, overriding the pool's policy.
+ */
+struct process_options {
+  std::string work_dir;
+  std::string stdout_file;
+  std::string stderr_file;
+  long timeout_ms;
+  long grace_ms;
+  std::vector<int> cpus;
+  process_options() : timeout_ms(-1), grace_ms(5000) {}
+};
+
+/**
+ * Outcome of a job.  exit_status is -1 if the job was killed by a signal
+ * (signal says which) or couldn't be started.
+ */
+struct process_result {
+  pid_t pid;
+  int exit_status;
+  int signal;
+  bool timed_out;
+  double wall_s;
+  double user_s;
+  double sys_s;
+  long max_rss_kb;
+};
+
+/**
+ * Parses a Linux cpu list (e.g., "0-15,32-47").
+ */
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (getline(ss,range,',')) {
+    if (range.find_first_not_of(" \t\n")==std::string::npos) {
+      continue;
+    }
+    std::string::size_type dash = range.find('-');
+    int lo = atoi(range.substr(0,dash).c_str());
+    int hi = (dash==std::string::npos) ? lo : atoi(range.substr(dash+1).c_str());
+    for (int c=lo; c<=hi; ++c) {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+/**
+ * Returns the cpus of each NUMA node, read from /sys.  A machine without
+ * NUMA information is treated as one node with every cpu this process
+ * may use.
+ */
+inline std::vector<std::vector<int> > numa_nodes() {
+
+  // Only the cpus this process may use count (cgroups, taskset)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0,sizeof(allowed),&allowed);
+
+  std::vector<std::vector<int> > nodes;
+  for (int n=0; ; ++n) {
+    std::ostringstream name;
+    name << "/sys/devices/system/node/node" << n << "/cpulist";
+    std::ifstream in(name.str().c_str());
+    std::string list;
+    if (!in.is_open() || !getline(in,list)) {
+      break;
+    }
+    std::vector<int> cpus;
+    for (int c : parse_cpu_list(list)) {
+      if (c<CPU_SETSIZE && CPU_ISSET(c,&allowed)) {
+        cpus.push_back(c);
+      }
+    }
+    if (!cpus.empty()) {
+      nodes.push_back(cpus);
+    }
+  }
+  if (nodes.empty()) {
+    std::vector<int> cpus;
+    for (int c=0; c<CPU_SETSIZE; ++c) {
+      if (CPU_ISSET(c,&allowed)) {
+        cpus.push_back(c);
+      }
+    }
+    nodes.push_back(cpus);
+  }
+  return nodes;
+
+}
+
+/**
+ * The process_pool class runs external commands (e.g., solver runs) on
+ * this machine, at most max_jobs at a time.  submit returns right away
+ * with a future, so the optimizer thread can carry on while the jobs run.
+ * A supervisor thread starts the jobs with posix_spawn, pins them to
+ * cpus, enforces timeouts (SIGTERM, then SIGKILL after a grace period, to
+ * the whole process group) and collects the exit status and resource use
+ * with wait4.
+ *
+ * Pinning is done by setting the affinity of the supervisor thread just
+ * before each spawn; the child inherits it.  Slots are fixed, so a job
+ * started in a slot gets the same cpus as the job before it, and jobs
+ * never share cpus when pin_cores is used.  Jobs which aren't pinned get
+ * the cpus the pool was created with, so a taskset or cgroup limit is kept.
+ *
+ * The supervisor sleeps in poll() on a pidfd for each running job (Linux
+ * 5.3 and later) and a pipe which wakes it when jobs are submitted, so it
+ * only runs when a job exits, a job is submitted or a timeout is due.
+ * Without pidfds it checks the jobs every 5 ms.
+ *
+ * Usage: process_pool pool(16,pin_cores,4);
+ *        std::future<process_result> f = pool.submit("./solver case.inp",opts);
+ *        ...
+ *        process_result r = f.get();
+ */
+
+class process_pool {
+
+  public:
+
+    /**
+     * ctor which starts the supervisor thread.
+     *
+     * @param[in] max_jobs maximum number of jobs running at once (0 means one per cores_per_job cpus).
+     * @param[in] policy how jobs are pinned (see pin_policy).
+     * @param[in] cores_per_job cpus given to each slot when policy is pin_cores.
+     */
+    process_pool(unsigned int max_jobs=0, const pin_policy policy=pin_none, const unsigned int cores_per_job=1) : running(true) {
+
+      CPU_ZERO(&allowed);
+      sched_getaffinity(0,sizeof(allowed),&allowed);
+      if (pipe2(wake_fd,O_NONBLOCK | O_CLOEXEC)!=0) {
+        throw std::runtime_error("Can't create pipe for process_pool.");
+      }
+
+      std::vector<std::vector<int> > nodes = numa_nodes();
+      std::vector<int> all;
+      for (auto& n : nodes) {
+        all.insert(all.end(),n.begin(),n.end());
+      }
+      unsigned int per_job = (cores_per_job>0) ? cores_per_job : 1;
+      if (max_jobs==0) {
+        max_jobs = (all.size()>=per_job) ? all.size()/per_job : 1;
+      }
+
+      // Working out the cpus of each slot
+      slots.resize(max_jobs);
+      for (unsigned int i=0; i<max_jobs; ++i) {
+        slots[i].busy = false;
+        if (policy==pin_cores) {
+          for (unsigned int k=0; k<per_job; ++k) {
+            slots[i].cpus.push_back(all[(i*per_job + k) % all.size()]);
+          }
+        }
+        else if (policy==pin_numa) {
+          slots[i].cpus = nodes[i % nodes.size()];
+        }
+      }
+      if (policy==pin_cores && max_jobs*per_job>all.size()) {
+        std::cerr << "\nWARNING: " << max_jobs << " jobs with " << per_job << " cpus each oversubscribe the " << all.size() << " cpus available." << std::endl;
+      }
+
+      supervisor = std::thread(&process_pool::supervise,this);
+
+    }
+
+    /**
+     * dtor which waits for every submitted job to finish.
+     */
+    ~process_pool() {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+      }
+      wake();
+      supervisor.join();
+      close(wake_fd[0]);
+      close(wake_fd[1]);
+    }
+
+    /**
+     * Method for queueing a command.  It's run through /bin/sh.
+     *
+     * @param[in] cmd command to be run.
+     * @param[in] opts working directory, output files, timeout and pinning (see process_options).
+     * @return A future which holds the outcome once the job has finished.
+     */
+    std::future<process_result> submit(const std::string cmd, const process_options opts=process_options()) {
+      std::shared_ptr<job> j(new job);
+      j->cmd = cmd;
+      j->opts = opts;
+      std::future<process_result> f = j->result.get_future();
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.push_back(j);
+      }
+      wake();
+      return f;
+    }
+
+    /**
+     * Method for dropping the queued jobs and killing the running ones.
+     * Their futures still get a result (timed_out is false, signal is set).
+     */
+    void kill_all() {
+      std::lock_guard<std::mutex> lock(mtx);
+      for (auto& j : queue) {
+        process_result r = failed_result();
+        r.signal = SIGKILL;
+        j->result.set_value(r);
+      }
+      queue.clear();
+      for (auto& s : slots) {
+        if (s.busy) {
+          kill(-s.current->pid,SIGKILL);
+        }
+      }
+    }
+
+    std::size_t size() const {
+      return slots.size();
+    }
+
+  private:
+
+    struct job {
+      std::string cmd;
+      process_options opts;
+      std::promise<process_result> result;
+      pid_t pid;
+      int pidfd;
+      std::chrono::steady_clock::time_point start;
+      bool terminated;
+      bool killed;
+    };
+
+    struct slot {
+      std::vector<int> cpus;
+      bool busy;
+      std::shared_ptr<job> current;
+    };
+
+    std::vector<slot> slots;
+    std::deque<std::shared_ptr<job> > queue;
+    bool running;
+    cpu_set_t allowed;
+    int wake_fd[2];
+    std::mutex mtx;
+    std::thread supervisor;
+
+    void wake() {
+      char c = 0;
+      ssize_t rc = write(wake_fd[1],&c,1);
+      (void) rc;
+    }
+
+    // Returns a descriptor which becomes readable when pid exits, or -1 if pidfds aren't supported
+    static int open_pidfd(const pid_t pid) {
+#ifdef SYS_pidfd_open
+      return static_cast<int>(syscall(SYS_pidfd_open,pid,0));
+#else
+      (void) pid;
+      return -1;
+#endif
+    }
+
+    // Resolves an output file against the job's working directory
+    static std::string in_work_dir(const process_options& opts, const std::string& file) {
+      return (opts.work_dir.empty() || file[0]=='/') ? file : opts.work_dir + "/" + file;
+    }
+
+    static process_result failed_result() {
+      process_result r;
+      r.pid = -1;
+      r.exit_status = -1;
+      r.signal = 0;
+      r.timed_out = false;
+      r.wall_s = r.user_s = r.sys_s = 0.0;
+      r.max_rss_kb = 0;
+      return r;
+    }
+
+    // Starts a job in a slot, returns false if it couldn't be spawned
+    bool spawn(slot& s, std::shared_ptr<job> j) {
+
+      // Pinning this thread so that the child inherits the affinity
+      const std::vector<int>& cpus = j->opts.cpus.empty() ? s.cpus : j->opts.cpus;
+      cpu_set_t set = allowed;
+      if (!cpus.empty()) {
+        CPU_ZERO(&set);
+        for (int c : cpus) {
+          CPU_SET(c,&set);
+        }
+      }
+      pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+
+      // Redirecting the output
+      posix_spawn_file_actions_t actions;
+      posix_spawn_file_actions_init(&actions);
+      std::string out = j->opts.stdout_file.empty() ? "/dev/null" : in_work_dir(j->opts,j->opts.stdout_file);
+      std::string err = j->opts.stderr_file.empty() ? "/dev/null" : in_work_dir(j->opts,j->opts.stderr_file);
+      posix_spawn_file_actions_addopen(&actions,STDIN_FILENO,"/dev/null",O_RDONLY,0);
+      posix_spawn_file_actions_addopen(&actions,STDOUT_FILENO,out.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+      posix_spawn_file_actions_addopen(&actions,STDERR_FILENO,err.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+
+      // Each job gets its own process group so that timeouts kill everything it started
+      posix_spawnattr_t attr;
+      posix_spawnattr_init(&attr);
+      posix_spawnattr_setflags(&attr,POSIX_SPAWN_SETPGROUP);
+      posix_spawnattr_setpgroup(&attr,0);
+
+      std::string full_cmd = j->opts.work_dir.empty() ? j->cmd : "cd " + shell_quote(j->opts.work_dir) + " && " + j->cmd;
+      const char* argv[] = {"/bin/sh","-c",full_cmd.c_str(),NULL};
+      j->start = std::chrono::steady_clock::now();
+      int rc = posix_spawn(&j->pid,"/bin/sh",&actions,&attr,const_cast<char* const*>(argv),environ);
+      posix_spawn_file_actions_destroy(&actions);
+      posix_spawnattr_destroy(&attr);
+      if (rc!=0) {
+        std::cerr << "\nERROR: Can't run " << j->cmd << ": " << strerror(rc) << std::endl;
+        j->result.set_value(failed_result());
+        return false;
+      }
+
+      j->pidfd = open_pidfd(j->pid);
+      j->terminated = false;
+      j->killed = false;
+      s.busy = true;
+      s.current = j;
+      return true;
+
+    }
+
+    // Checks on a running job, returns true once it has been reaped
+    bool reap(slot& s) {
+
+      std::shared_ptr<job> j = s.current;
+      int status;
+      struct rusage ru;
+      pid_t rc = wait4(j->pid,&status,WNOHANG,&ru);
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+      if (rc==0) {
+        // Still running, so enforcing the timeout
+        long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now-j->start).count();
+        if (j->opts.timeout_ms>=0 && !j->terminated && elapsed>j->opts.timeout_ms) {
+          kill(-j->pid,SIGTERM);
+          j->terminated = true;
+        }
+        else if (j->terminated && !j->killed && elapsed>j->opts.timeout_ms+j->opts.grace_ms) {
+          kill(-j->pid,SIGKILL);
+          j->killed = true;
+        }
+        return false;
+      }
+
+      process_result r = failed_result();
+      r.pid = j->pid;
+      if (rc>0) {
+        if (WIFEXITED(status)) {
+          r.exit_status = WEXITSTATUS(status);
+        }
+        else if (WIFSIGNALED(status)) {
+          r.signal = WTERMSIG(status);
+        }
+        r.user_s = ru.ru_utime.tv_sec + 1.0e-6*ru.ru_utime.tv_usec;
+        r.sys_s = ru.ru_stime.tv_sec + 1.0e-6*ru.ru_stime.tv_usec;
+        r.max_rss_kb = ru.ru_maxrss;
+      }
+      r.timed_out = j->terminated;
+      r.wall_s = std::chrono::duration<double>(now-j->start).count();
+
+      // Anything else left in the process group goes too
+      kill(-j->pid,SIGKILL);
+      if (j->pidfd>=0) {
+        close(j->pidfd);
+      }
+
+      s.busy = false;
+      s.current.reset();
+      j->result.set_value(r);
+      return true;
+
+    }
+
+    void supervise() {
+
+      std::unique_lock<std::mutex> lock(mtx);
+      while (true) {
+
+        // Starting queued jobs in free slots
+        for (auto& s : slots) {
+          while (!s.busy && !queue.empty()) {
+            std::shared_ptr<job> j = queue.front();
+            queue.pop_front();
+            spawn(s,j);
+          }
+        }
+
+        // Reaping finished jobs
+        bool any_running = false;
+        bool any_reaped = false;
+        for (auto& s : slots) {
+          if (s.busy) {
+            if (reap(s)) {
+              any_reaped = true;
+            }
+            else {
+              any_running = true;
+            }
+          }
+        }
+
+        if (!running && !any_running && queue.empty()) {
+          break;
+        }
+        if (any_reaped) {
+          continue;
+        }
+
+        // Sleeping until a job exits, a job is submitted or the next timeout is due
+        std::vector<struct pollfd> fds(1);
+        fds[0].fd = wake_fd[0];
+        fds[0].events = POLLIN;
+        long wait_ms = -1;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (auto& s : slots) {
+          if (!s.busy) {
+            continue;
+          }
+          const job& j = *s.current;
+          long next_ms = -1;
+          if (j.pidfd>=0) {
+            struct pollfd p;
+            p.fd = j.pidfd;
+            p.events = POLLIN;
+            fds.push_back(p);
+          }
+          else {
+            next_ms = 5;
+          }
+          if (j.opts.timeout_ms>=0 && !j.killed) {
+            long due = j.terminated ? j.opts.timeout_ms+j.opts.grace_ms : j.opts.timeout_ms;
+            long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now-j.start).count();
+            long left = std::max<long>(due-elapsed+1,0);
+            next_ms = (next_ms<0) ? left : std::min(next_ms,left);
+          }
+          if (next_ms>=0) {
+            wait_ms = (wait_ms<0) ? next_ms : std::min(wait_ms,next_ms);
+          }
+        }
+        lock.unlock();
+        ::poll(fds.data(),fds.size(),static_cast<int>(wait_ms));
+        char buffer[64];
+        while (read(wake_fd[0],buffer,sizeof(buffer))>0) {}
+        lock.lock();
+
+      }
+
+    }
+
+    process_pool(const process_pool&);
+    process_pool& operator=(const process_pool&);
+
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REMOTEJOBSHEADERDEF
+#define REMOTEJOBSHEADERDEF
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
+#include "remote_tools.h"
+
+/**
+ * Callback which is called when a job finishes.  It receives the id
+ * returned by submit and the job's output.
+ */
+typedef std::function<void(unsigned int, const exec_result&)> job_callback;
+
+/**
+ * The remote_job_manager class runs many remote commands at once from a
+ * single thread.  Jobs are queued with submit and started as soon as
+ * their host has a free slot; each job runs on its own channel, and the
+ * channels are spread over a few sessions per host.  run() waits on the
+ * sockets of all the sessions with poll(), so the driver thread sleeps
+ * until one of the jobs has output, and the callback of each job is
+ * called as soon as it finishes.  Callbacks may submit more jobs.
+ *
+ * Sessions are opened the first time a host is used, and reopened if they
+ * are dropped (the jobs running on a dropped session fail).  Everything,
+ * including submit, must be called from the thread which calls run().
+ *
+ * Usage: remote_job_manager jobs(2);
+ *        jobs.set_host_limit("user@node1",16);
+ *        jobs.submit("user@node1","./solver case1",callback);
+ *        jobs.run();
+ */
+
+class remote_job_manager {
+
+  public:
+    remote_job_manager(const unsigned int sessions_per_host=1, const unsigned int default_limit=8);
+    ~remote_job_manager();
+    void set_host_limit(const std::string target, const unsigned int max_jobs);
+    unsigned int submit(const std::string target, const std::string cmd, job_callback callback=job_callback(), const exec_options opts=exec_options());
+    bool step(const int timeout_ms);
+    void run();
+    void cancel_all();
+    std::size_t pending() const;
+    std::size_t running() const;
+
+  private:
+
+    struct job {
+      unsigned int id;
+      std::string cmd;
+      job_callback callback;
+      exec_options opts;
+    };
+
+    struct running_job {
+      unsigned int id;
+      unsigned int session;
+      job_callback callback;
+      std::unique_ptr<remote_command> command;
+    };
+
+    struct host_state {
+      std::vector<std::unique_ptr<connection> > sessions;
+      unsigned int next_session;
+      unsigned int limit;
+      std::deque<job> queue;
+      std::vector<running_job> active;
+    };
+
+    unsigned int nsessions;
+    unsigned int default_limit;
+    unsigned int next_id;
+    std::map<std::string,host_state> hosts;
+
+    host_state& host(const std::string& target);
+    void start_jobs(const std::string& target, host_state& h);
+    bool collect();
+
+    remote_job_manager(const remote_job_manager&);
+    remote_job_manager& operator=(const remote_job_manager&);
+
+};
+
+#endif
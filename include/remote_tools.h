@@ -19,7 +19,103 @@
 #define REMOTEHEADERDEF
 
 #include <string>
+#include <sstream>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+#include <boost/lexical_cast.hpp>
 #include <libssh/libssh.h>
+#include <libssh/sftp.h>
+#include "exec_types.h"
+#include "errors.h"
+
+/**
+ * Options for the pipelined SFTP transfers (put_files and get_files).
+ *
+ *   max_requests : read/write requests kept outstanding per session.
+ *   max_files    : files transferred at the same time.
+ *   chunk_size   : bytes per request (capped by the server's limits).
+ */
+struct sftp_options {
+  unsigned int max_requests;
+  unsigned int max_files;
+  std::size_t chunk_size;
+  sftp_options() : max_requests(64), max_files(8), chunk_size(65536) {}
+};
+
+typedef std::vector<std::pair<std::string,std::string> > transfer_list;
+
+/**
+ * Options for sync_dir.
+ *
+ *   use_hash        : also compare md5 sums of files whose size and mtime match.
+ *   delete_extra    : remove remote files which aren't in the local tree.
+ *   block_threshold : files at least this big are updated block by block.
+ *   block_size      : size of the blocks which are compared.
+ */
+struct sync_options {
+  bool use_hash;
+  bool delete_extra;
+  uint64_t block_threshold;
+  std::size_t block_size;
+  sync_options() : use_hash(false), delete_extra(false), block_threshold(8388608), block_size(1048576) {}
+};
+
+/**
+ * Result of a remote stat (see connection::stat_files).
+ */
+struct remote_stat {
+  std::string path;
+  bool exists;
+  bool is_dir;
+  uint64_t size;
+  int64_t mtime;
+  unsigned int mode;
+};
+
+/**
+ * A command which is running on the remote host.  It is returned by
+ * connection::exec_async and runs on its own channel, so any number of
+ * commands can run at once over one session.  poll() collects whatever
+ * output has arrived without blocking, and wait() blocks until the command
+ * is finished.  A remote_command must not outlive its connection, and the
+ * commands on one connection must all be driven from the same thread.
+ */
+class remote_command {
+
+  public:
+    remote_command(ssh_session session, const std::string cmd, const exec_options opts);
+    remote_command(remote_command&& other);
+    ~remote_command();
+    bool poll();
+    void write(const char* data, const std::size_t len);
+    void send_eof();
+    bool done() const;
+    const exec_result& wait();
+    const exec_result& result() const;
+    void cancel();
+    static void wait_all(std::vector<remote_command>& commands);
+
+  private:
+    friend class remote_job_manager;
+    ssh_session session;
+    ssh_channel channel;
+    std::string command;
+    exec_options options;
+    exec_result res;
+    std::size_t input_sent;
+    bool stdin_closed;
+    bool finished;
+    std::chrono::steady_clock::time_point start;
+
+    void finish(const bool timed_out);
+    void feed_input();
+    void fail(const char* what);
+    remote_command(const remote_command&);
+    remote_command& operator=(const remote_command&);
+
+};
 
 class connection {
 
@@ -30,18 +126,94 @@ class connection {
     int hlen;
     unsigned char* hash;
     bool connection_open;
-    ssh_channel channel;
-    ssh_scp scp;
+    std::string host;
+    sftp_session sftp;
+    int compression_level;
+
+    sftp_session sftp_handle();
+    static std::string sftp_path(const std::string& path);
+    void sftp_transfer(const transfer_list& files, const bool upload, const sftp_options& opts);
+
+    static std::string quote_path(const std::string& path);
+
+    // Converts a field, throwing a parse_error if it isn't a T
+    template <typename T>
+    static T convert_field(const std::string& field, const remote_value& v) {
+      try {
+        return boost::lexical_cast<T>(field);
+      }
+      catch (const boost::bad_lexical_cast&) {
+        std::ostringstream msg;
+        msg << "Can't convert " << field << " (";
+        if (v.label.empty()) {
+          msg << "line " << v.line_num;
+        }
+        else {
+          msg << "row " << v.label;
+        }
+        msg << ", index " << v.pos << " of remote file " << v.file << ").";
+        throw parse_error(msg.str());
+      }
+    }
+    uint64_t sync_blocks(const std::string& local_file, const std::string& remote_file, const uint64_t remote_size, const std::size_t block_size);
+    void resume_file(const std::string trgt, const std::string local_file, const uint64_t offset, const std::size_t chunk_size);
+
+    // Sessions can't be shared, so connections can't be copied
+    connection(const connection&);
+    connection& operator=(const connection&);
 
   public:
     connection();
     ~connection();
+    void set_compression(const int level);
     void open_connection(const std::string target);
     void close_connection();
+    bool is_open() const;
+    bool keepalive();
+    std::string target() const;
     void list_dir(const std::string dir);
+    exec_result exec(const std::string cmd, const exec_options opts=exec_options());
+    remote_command exec_async(const std::string cmd, const exec_options opts=exec_options());
     bool check_file_existence(const std::string dir, const std::string filename);
-    void put_file(const std::string src_file, const std::string target_dir);
-    void get_file(const std::string target_file, const std::string target_dir, const std::string local_file);
+    std::vector<remote_stat> stat_files(const std::vector<std::string>& paths);
+    void put_file(const std::string src_file, const std::string target_dir, const std::size_t chunk_size=1048576);
+    void get_file(const std::string target_file, const std::string target_dir, const std::string local_file, const bool resume=false, const std::size_t chunk_size=1048576);
+    void put_files(const transfer_list& files, const sftp_options opts=sftp_options());
+    void get_files(const transfer_list& files, const sftp_options opts=sftp_options());
+    uint64_t sync_dir(const std::string local_dir, const std::string remote_dir, const sync_options opts=sync_options());
+    void put_dir(const std::string local_dir, const std::string remote_dir, const int level=6);
+    void get_dir(const std::string remote_dir, const std::string local_dir, const int level=6);
+    std::vector<std::string> get_remote_fields(const std::vector<remote_value>& values);
+
+    /**
+     * Method for reading one value from a file on the remote host without
+     * transferring the file.  Same semantics as get_value.
+     *
+     * @param[in] remote_file path of the file on the remote host.
+     * @param[in] line_num line number to grab data from (zero-based).
+     * @param[in] pos position of the field in the line (zero-based).
+     * @return The value, converted with lexical_cast (parse_error if it can't be).
+     */
+    template <typename T>
+    T get_remote_value(const std::string remote_file, const unsigned int line_num, const unsigned int pos) {
+      std::vector<remote_value> values(1,remote_value(remote_file,line_num,pos));
+      return convert_field<T>(get_remote_fields(values)[0],values[0]);
+    }
+
+    /**
+     * Method for reading one value from a labeled line of a file on the
+     * remote host without transferring the file.
+     *
+     * @param[in] remote_file path of the file on the remote host.
+     * @param[in] label first field of the line (e.g., Net).
+     * @param[in] pos position of the field in the line (zero-based, 0 is the label).
+     * @return The value, converted with lexical_cast (parse_error if it can't be).
+     */
+    template <typename T>
+    T get_remote_value(const std::string remote_file, const std::string label, const unsigned int pos) {
+      std::vector<remote_value> values(1,remote_value(remote_file,label,pos));
+      return convert_field<T>(get_remote_fields(values)[0],values[0]);
+    }
 
 };
 
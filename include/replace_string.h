@@ -14,3 +14,205 @@
  * You should have received a copy of the GNU General Public License
  * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
  */
+
+#ifndef REPLACESTRINGHEADERDEF
+#define REPLACESTRINGHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "errors.h"
+
+/**
+ * The replace_var_str function replaces every occurrence of var in a
+ * string with the value val.  It's the in-memory version of replace_var
+ * (file_ops.h) and formats numbers the same way.
+ *
+ * @param text string in which var is replaced.
+ * @param var variable which will be searched for.
+ * @param val value that will replace all occurences of the variable provided.
+ * @param numfmt number format of the std::ostringstream (optional, default is std::fixed).
+ * @return The number of occurrences which were replaced.
+ */
+template <typename T>
+std::size_t replace_var_str(std::string& text, const std::string var, const T val, const std::string numfmt="fixed") {
+  std::ostringstream valstring;
+  if (numfmt.compare("fixed")==0) {
+    valstring << std::fixed;
+  }
+  else if (numfmt.compare("scientific")==0) {
+    valstring << std::scientific;
+  }
+  valstring << val;
+  const std::string valstr = valstring.str();
+  std::size_t count = 0;
+  std::size_t found = text.find(var);
+  while (found!=std::string::npos) {
+    text.replace(found,var.length(),valstr);
+    count++;
+    found = text.find(var,found+valstr.length());
+  }
+  return count;
+}
+
+/**
+ * The input_deck class holds a solver input file in memory so that it can
+ * be rendered with new values for each evaluation without touching the
+ * disk.  The template is read once and the places where each variable
+ * appears are found once, so rendering is a single pass which copies the
+ * text between them.  The rendered deck is meant to be fed to a solver
+ * which reads its input from stdin (see exec_options::input), locally or
+ * on a remote host.
+ *
+ * Usage: input_deck deck("case.inp");
+ *        deck.set("XVAR",1.5);
+ *        exec_options opts;
+ *        opts.input = deck.render();
+ *        exec_result r = ex.run("./solver",opts);
+ */
+
+class input_deck {
+
+  public:
+
+    /**
+     * ctor which reads the template from a file.
+     *
+     * @param[in] filename name of the template.
+     */
+    explicit input_deck(const std::string filename) {
+      std::ifstream infile(filename.c_str(),std::ios::binary);
+      if (!infile.is_open()) {
+        std::ostringstream msg;
+        msg << "Can't open " << filename;
+        throw file_error(msg.str());
+      }
+      std::ostringstream contents;
+      contents << infile.rdbuf();
+      text = contents.str();
+    }
+
+    /**
+     * Method for making a deck from a template which is already in memory.
+     *
+     * @param[in] contents the template.
+     */
+    static input_deck from_string(const std::string contents) {
+      input_deck deck;
+      deck.text = contents;
+      return deck;
+    }
+
+    /**
+     * Method for setting the value which replaces a variable.
+     *
+     * @param[in] var variable which will be searched for.
+     * @param[in] val value which replaces it.
+     * @param[in] numfmt number format (optional, default is std::fixed).
+     */
+    template <typename T>
+    void set(const std::string var, const T val, const std::string numfmt="fixed") {
+      std::ostringstream valstring;
+      if (numfmt.compare("fixed")==0) {
+        valstring << std::fixed;
+      }
+      else if (numfmt.compare("scientific")==0) {
+        valstring << std::scientific;
+      }
+      valstring << val;
+      std::map<std::string,std::size_t>::const_iterator it = var_index.find(var);
+      if (it==var_index.end()) {
+        add_var(var);
+        it = var_index.find(var);
+      }
+      values[it->second] = valstring.str();
+    }
+
+    /**
+     * Method for rendering the deck with the values which have been set.
+     *
+     * @return The deck.
+     */
+    std::string render() const {
+      std::string out;
+      out.reserve(text.size()+64*hits.size());
+      std::size_t prev = 0;
+      for (auto& h : hits) {
+        out.append(text,prev,h.pos-prev);
+        out += values[h.var];
+        prev = h.pos + vars[h.var].size();
+      }
+      out.append(text,prev,std::string::npos);
+      return out;
+    }
+
+    /**
+     * Method for writing the rendered deck to a stream (e.g., a pipe).
+     */
+    void render(std::ostream& out) const {
+      std::size_t prev = 0;
+      for (auto& h : hits) {
+        out.write(text.data()+prev,h.pos-prev);
+        out << values[h.var];
+        prev = h.pos + vars[h.var].size();
+      }
+      out.write(text.data()+prev,text.size()-prev);
+    }
+
+  private:
+
+    struct hit {
+      std::size_t pos;
+      std::size_t var;
+      bool operator<(const hit& other) const {
+        return pos<other.pos;
+      }
+    };
+
+    std::string text;
+    std::vector<std::string> vars;
+    std::vector<std::string> values;
+    std::map<std::string,std::size_t> var_index;
+    std::vector<hit> hits;
+
+    input_deck() {}
+
+    // Finds where a variable appears (places already taken by another variable are skipped)
+    void add_var(const std::string& var) {
+      std::size_t v = vars.size();
+      vars.push_back(var);
+      values.push_back(var);
+      var_index[var] = v;
+      std::vector<hit> found;
+      std::size_t p = var.empty() ? std::string::npos : text.find(var);
+      while (p!=std::string::npos) {
+        bool overlaps = false;
+        for (auto& h : hits) {
+          if (p<h.pos+vars[h.var].size() && h.pos<p+var.size()) {
+            overlaps = true;
+            break;
+          }
+        }
+        if (!overlaps) {
+          hit h;
+          h.pos = p;
+          h.var = v;
+          found.push_back(h);
+        }
+        p = text.find(var,p+var.size());
+      }
+      if (found.empty()) {
+        std::cout << "WARNING: Did not find " << var << " in the input deck." << std::endl;
+      }
+      hits.insert(hits.end(),found.begin(),found.end());
+      std::sort(hits.begin(),hits.end());
+    }
+
+};
+
+#endif
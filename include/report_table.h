@@ -0,0 +1,284 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPORTTABLEHEADERDEF
+#define REPORTTABLEHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+#include <unordered_map>
+#include "boost/lexical_cast.hpp"
+#include "errors.h"
+
+/**
+ * The report_table class parses a tabular report file (e.g., the volume
+ * integral reports written by the solver, see tests/Tavg.dat) once and
+ * builds an in-memory index of it.  Rows are addressed by their label (the
+ * first whitespace-separated field of the row) and columns are addressed
+ * either by header text or by field position.  Field positions follow the
+ * same convention as get_value, so position 0 is the label itself.
+ *
+ * Columns are found using the first line made up only of dashes.  Each run
+ * of dashes defines the character span of one column, and the non-blank
+ * lines directly above the dashes are the header.  A header word belongs
+ * to the column in which it starts.  If the file has no dashed line, the
+ * first non-blank line is used as a whitespace-separated header.
+ *
+ * If a label appears more than once, the first row with that label is used.
+ */
+
+class report_table {
+
+  public:
+
+    /**
+     * ctor which reads and indexes the given file.
+     *
+     * @param[in] filename name of the report file.
+     */
+    explicit report_table(const std::string filename) : source(filename) {
+      std::ifstream infile(filename.c_str());
+      if (!infile.is_open()) {
+        std::ostringstream msg;
+        msg << "Can't open " << filename;
+        throw file_error(msg.str());
+      }
+      parse(infile);
+    }
+
+    /**
+     * ctor which reads and indexes a table from a stream.
+     *
+     * @param[in] input stream containing the table.
+     * @param[in] name name used in error messages.
+     */
+    report_table(std::istream& input, const std::string name) : source(name) {
+      parse(input);
+    }
+
+    /**
+     * Method for getting a value using a row label and a column header.
+     *
+     * @param[in] row_label label of the row (e.g., Net).
+     * @param[in] column header text of the column.
+     * @return The value converted to type T.
+     */
+    template <typename T>
+    T get(const std::string row_label, const std::string column) const {
+      std::unordered_map<std::string,std::size_t>::const_iterator it = col_index.find(column);
+      if (it==col_index.end()) {
+        std::ostringstream msg;
+        msg << "Didn't find column " << column << " in file named " << source << ". Available columns:";
+        for (auto& c : col_index) {
+          msg << "\nindex: " << c.second << " header: " << c.first;
+        }
+        throw parse_error(msg.str());
+      }
+      return get<T>(row_label,static_cast<unsigned int>(it->second));
+    }
+
+    /**
+     * Method for getting a value using a row label and a field position.
+     *
+     * @param[in] row_label label of the row (e.g., Net).
+     * @param[in] pos position of the field in the row (zero-based, 0 is the label).
+     * @return The value converted to type T.
+     */
+    template <typename T>
+    T get(const std::string row_label, const unsigned int pos) const {
+      const std::vector<std::string>& fields = row(row_label);
+      if (pos>=fields.size()) {
+        std::ostringstream msg;
+        msg << "Requested index " << pos << " doesn't exist in row " << row_label << ".";
+        for (unsigned int i=0; i<fields.size(); ++i) {
+          msg << "\nindex: " << i << " entry: " << fields[i];
+        }
+        throw parse_error(msg.str());
+      }
+      try {
+        return boost::lexical_cast<T>(fields[pos]);
+      }
+      catch (const boost::bad_lexical_cast&) {
+        std::ostringstream msg;
+        msg << "Can't convert " << fields[pos] << " (row " << row_label << ", index " << pos << " of " << source << ").";
+        throw parse_error(msg.str());
+      }
+    }
+
+    /**
+     * Method for getting all of the fields in a row.
+     *
+     * @param[in] row_label label of the row.
+     * @return The whitespace-separated fields of the row, including the label.
+     */
+    const std::vector<std::string>& row(const std::string row_label) const {
+      std::unordered_map<std::string,std::size_t>::const_iterator it = row_index.find(row_label);
+      if (it==row_index.end()) {
+        std::ostringstream msg;
+        msg << "Didn't find row labeled " << row_label << " in file named " << source;
+        throw parse_error(msg.str());
+      }
+      return rows[it->second];
+    }
+
+    bool has_row(const std::string row_label) const {
+      return row_index.find(row_label)!=row_index.end();
+    }
+
+    bool has_column(const std::string column) const {
+      return col_index.find(column)!=col_index.end();
+    }
+
+    std::size_t num_rows() const {
+      return rows.size();
+    }
+
+  private:
+
+    std::string source;
+    std::vector<std::vector<std::string> > rows;
+    std::unordered_map<std::string,std::size_t> row_index;
+    std::unordered_map<std::string,std::size_t> col_index;
+
+    // Splits a line into whitespace-separated fields (same as get_value)
+    static std::vector<std::string> split(const std::string& line) {
+      std::stringstream ss(line);
+      std::istream_iterator<std::string> begin(ss);
+      std::istream_iterator<std::string> end;
+      return std::vector<std::string>(begin,end);
+    }
+
+    static bool is_blank(const std::string& line) {
+      return line.find_first_not_of(" \t\r")==std::string::npos;
+    }
+
+    static bool is_separator(const std::string& line) {
+      return line.find('-')!=std::string::npos && line.find_first_not_of("- \t\r")==std::string::npos;
+    }
+
+    // Adds a header for column icol, keeping the first column if the header repeats
+    void add_column(const std::string& header, const std::size_t icol) {
+      if (!header.empty()) {
+        col_index.insert(std::make_pair(header,icol));
+      }
+    }
+
+    void parse(std::istream& input) {
+
+      // Reading all lines
+      std::vector<std::string> lines;
+      std::string line;
+      while (getline(input,line)) {
+        lines.push_back(line);
+      }
+
+      // Finding the dashed line which separates the header from the data
+      std::size_t sep = lines.size();
+      for (std::size_t i=0; i<lines.size(); ++i) {
+        if (is_separator(lines[i])) {
+          sep = i;
+          break;
+        }
+      }
+
+      std::size_t first_data;
+      if (sep<lines.size()) {
+
+        // Finding column spans from the runs of dashes
+        std::vector<std::size_t> span_begin, span_end;
+        const std::string& dashes = lines[sep];
+        std::size_t p = dashes.find('-');
+        while (p!=std::string::npos) {
+          std::size_t q = dashes.find_first_not_of('-',p);
+          span_begin.push_back(p);
+          span_end.push_back(q==std::string::npos ? dashes.size() : q);
+          p = (q==std::string::npos) ? q : dashes.find('-',q);
+        }
+
+        // Header lines are the non-blank lines directly above the dashes
+        std::size_t hbegin = sep;
+        while (hbegin>0 && !is_blank(lines[hbegin-1])) {
+          --hbegin;
+        }
+
+        // Assigning each header word to the column in which it starts
+        std::vector<std::string> full(span_begin.size());
+        for (std::size_t i=hbegin; i<sep; ++i) {
+          std::vector<std::string> partial(span_begin.size());
+          const std::string& h = lines[i];
+          std::size_t w = h.find_first_not_of(" \t\r");
+          while (w!=std::string::npos) {
+            std::size_t we = h.find_first_of(" \t\r",w);
+            std::string word = h.substr(w,we==std::string::npos ? std::string::npos : we-w);
+            for (std::size_t k=0; k<span_begin.size(); ++k) {
+              std::size_t limit = (k+1<span_begin.size()) ? span_begin[k+1] : std::string::npos;
+              if (w<limit && (w>=span_begin[k] || k==0)) {
+                partial[k] += (partial[k].empty() ? "" : " ") + word;
+                break;
+              }
+            }
+            w = (we==std::string::npos) ? we : h.find_first_not_of(" \t\r",we);
+          }
+          for (std::size_t k=0; k<partial.size(); ++k) {
+            add_column(partial[k],k);
+            if (!partial[k].empty()) {
+              full[k] += (full[k].empty() ? "" : " ") + partial[k];
+            }
+          }
+        }
+        for (std::size_t k=0; k<full.size(); ++k) {
+          add_column(full[k],k);
+        }
+        first_data = sep + 1;
+
+      }
+      else {
+
+        // No dashed line, so the first non-blank line is the header
+        std::size_t h = 0;
+        while (h<lines.size() && is_blank(lines[h])) {
+          ++h;
+        }
+        if (h<lines.size()) {
+          std::vector<std::string> headers = split(lines[h]);
+          for (std::size_t k=0; k<headers.size(); ++k) {
+            add_column(headers[k],k);
+          }
+        }
+        first_data = h + 1;
+
+      }
+
+      // Indexing the data rows by label
+      for (std::size_t i=first_data; i<lines.size(); ++i) {
+        if (is_blank(lines[i]) || is_separator(lines[i])) {
+          continue;
+        }
+        rows.push_back(split(lines[i]));
+        row_index.insert(std::make_pair(rows.back()[0],rows.size()-1));
+      }
+
+    }
+
+};
+
+#endif
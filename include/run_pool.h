@@ -0,0 +1,375 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RUNPOOLHEADERDEF
+#define RUNPOOLHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <vector>
+#include <map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "file_ops.h"
+
+/**
+ * The run_dir_pool class keeps a fixed number of case directories which
+ * are cloned from a template directory once, up front.  Evaluations
+ * acquire a directory, run in it, and release it back to the pool.  When a
+ * directory is released, only the files which the evaluation changed are
+ * put back the way they were in the template:
+ *
+ *   - files whose size, mtime or inode changed are placed again,
+ *   - files which were deleted are placed again,
+ *   - files and directories which weren't in the template are removed.
+ *
+ * If the caller knows which files were touched, it can pass them as a
+ * manifest and only those are reset, which skips the walk of the
+ * directory.  The root can be put on tmpfs (e.g., /dev/shm/cases) so that
+ * evaluations never touch the disk.  Files which are hard linked by the
+ * clone policy are shared with the template and are never reset.
+ *
+ * If a directory can't be reset, it's still returned to the pool but
+ * marked dirty, and it's cloned again from the template the next time it
+ * is acquired.
+ */
+
+class run_dir_pool {
+
+  public:
+
+    /**
+     * ctor which provisions the case directories.
+     *
+     * @param[in] template_dir directory which is cloned into each case directory.
+     * @param[in] root directory in which the case directories are made (created if needed).
+     * @param[in] n number of case directories.
+     * @param[in] policy how each file is placed (see clone_tree).
+     * @param[in] keep if true, the case directories are left behind by the dtor.
+     */
+    run_dir_pool(const std::string template_dir, const std::string root, const unsigned int n, std::function<copy_method(const std::string&)> policy=default_clone_policy, const bool keep=false) : tmpl(template_dir), policy(policy), keep(keep) {
+
+      if (mkdir(root.c_str(),0777)!=0 && errno!=EEXIST) {
+        std::ostringstream msg;
+        msg << "Can't create directory " << root << ": " << strerror(errno);
+        throw file_error(msg.str());
+      }
+
+      // Recording what the template looks like
+      scan(tmpl,"",template_files);
+
+      // Cloning the template into each case directory
+      dirs.resize(n);
+      for (unsigned int i=0; i<n; ++i) {
+        std::ostringstream name;
+        name << root << "/run_" << i;
+        dirs[i].path = name.str();
+        dirs[i].in_use = false;
+        provision(dirs[i]);
+        free_dirs.push_back(i);
+      }
+
+    }
+
+    /**
+     * dtor which removes the case directories unless keep was set.  A
+     * directory which can't be removed is reported and left behind.
+     */
+    ~run_dir_pool() {
+      if (!keep) {
+        for (auto& d : dirs) {
+          try {
+            remove_tree(d.path);
+          }
+          catch (std::exception& e) {
+            std::cerr << "WARNING: " << e.what() << std::endl;
+          }
+        }
+      }
+    }
+
+    /**
+     * Method for getting a case directory.  Blocks until one is free.  A
+     * dirty directory is cloned again first.
+     *
+     * @return path of the case directory.
+     */
+    std::string acquire() {
+      unsigned int i;
+      bool dirty;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        available.wait(lock,[this] () {return !free_dirs.empty();});
+        i = free_dirs.back();
+        free_dirs.pop_back();
+        dirs[i].in_use = true;
+        dirty = dirs[i].dirty;
+      }
+      if (dirty) {
+        try {
+          provision(dirs[i]);
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> lock(mtx);
+          dirs[i].in_use = false;
+          free_dirs.push_back(i);
+          available.notify_one();
+          throw;
+        }
+      }
+      return dirs[i].path;
+    }
+
+    /**
+     * Method for returning a case directory to the pool.  The directory
+     * is reset before it's handed out again.
+     *
+     * @param[in] path path returned by acquire.
+     * @param[in] manifest files (relative to the case directory) which were changed.  If empty, the whole directory is checked.
+     * @throw file_error if the directory couldn't be reset (it's returned to the pool as dirty anyway).
+     */
+    void release(const std::string path, const std::vector<std::string>& manifest=std::vector<std::string>()) {
+
+      unsigned int i = index_of(path);
+      std::exception_ptr error;
+      try {
+        if (manifest.empty()) {
+          reset(dirs[i]);
+        }
+        else {
+          for (auto& rel : manifest) {
+            reset_file(dirs[i],rel);
+          }
+        }
+      }
+      catch (...) {
+        error = std::current_exception();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        dirs[i].in_use = false;
+        dirs[i].dirty = bool(error);
+        free_dirs.push_back(i);
+        available.notify_one();
+      }
+      if (error) {
+        std::rethrow_exception(error);
+      }
+
+    }
+
+    std::size_t size() const {
+      return dirs.size();
+    }
+
+  private:
+
+    struct file_state {
+      off_t size;
+      long long mtime_ns;
+      ino_t ino;
+      bool is_dir;
+    };
+
+    struct case_dir {
+      std::string path;
+      bool in_use;
+      bool dirty;
+      std::map<std::string,file_state> snapshot;
+    };
+
+    std::string tmpl;
+    std::function<copy_method(const std::string&)> policy;
+    bool keep;
+    std::map<std::string,file_state> template_files;
+    std::vector<case_dir> dirs;
+    std::vector<unsigned int> free_dirs;
+    std::mutex mtx;
+    std::condition_variable available;
+
+    // Clones the template into the directory from scratch
+    void provision(case_dir& d) {
+      d.dirty = true;
+      remove_tree(d.path);
+      clone_tree(tmpl,d.path,policy);
+      d.snapshot.clear();
+      scan(d.path,"",d.snapshot);
+      d.dirty = false;
+    }
+
+    static bool state_of(const std::string& path, file_state& fs) {
+      struct stat ss;
+      if (lstat(path.c_str(),&ss)!=0) {
+        return false;
+      }
+      fs.size = ss.st_size;
+      fs.mtime_ns = static_cast<long long>(ss.st_mtim.tv_sec)*1000000000LL + ss.st_mtim.tv_nsec;
+      fs.ino = ss.st_ino;
+      fs.is_dir = S_ISDIR(ss.st_mode);
+      return true;
+    }
+
+    // Records the state of everything under base/rel, keyed by relative path
+    static void scan(const std::string& base, const std::string& rel, std::map<std::string,file_state>& files) {
+      std::string dir = rel.empty() ? base : base + "/" + rel;
+      DIR* dp = opendir(dir.c_str());
+      if (dp==NULL) {
+        return;
+      }
+      struct dirent* entry;
+      while ((entry = readdir(dp))!=NULL) {
+        std::string name(entry->d_name);
+        if (name=="." || name=="..") {
+          continue;
+        }
+        std::string r = rel.empty() ? name : rel + "/" + name;
+        file_state fs;
+        if (state_of(base + "/" + r,fs)) {
+          files[r] = fs;
+          if (fs.is_dir) {
+            scan(base,r,files);
+          }
+        }
+      }
+      closedir(dp);
+    }
+
+    unsigned int index_of(const std::string& path) {
+      std::lock_guard<std::mutex> lock(mtx);
+      for (unsigned int i=0; i<dirs.size(); ++i) {
+        if (dirs[i].path==path && dirs[i].in_use) {
+          return i;
+        }
+      }
+      std::ostringstream msg;
+      msg << path << " was not acquired from this run_dir_pool.";
+      throw file_error(msg.str());
+    }
+
+    // Puts one file back the way it is in the template
+    void reset_file(case_dir& d, const std::string& rel) {
+      std::string target = d.path + "/" + rel;
+      std::map<std::string,file_state>::const_iterator t = template_files.find(rel);
+      if (t==template_files.end()) {
+        remove_tree(target);
+        d.snapshot.erase(rel);
+        return;
+      }
+      if (t->second.is_dir) {
+        return;
+      }
+      std::string source = tmpl + "/" + rel;
+      place_file(source,target,policy(source));
+      state_of(target,d.snapshot[rel]);
+    }
+
+    // Puts back everything in the directory which differs from the snapshot
+    void reset(case_dir& d) {
+
+      std::map<std::string,file_state> current;
+      scan(d.path,"",current);
+
+      // Removing new files and resetting changed ones
+      for (auto& kv : current) {
+        std::map<std::string,file_state>::const_iterator s = d.snapshot.find(kv.first);
+        if (s==d.snapshot.end()) {
+          // Anything under a directory which is removed is already gone
+          if (accessible(d.path + "/" + kv.first)) {
+            reset_file(d,kv.first);
+          }
+        }
+        else if (!kv.second.is_dir && (kv.second.size!=s->second.size || kv.second.mtime_ns!=s->second.mtime_ns || kv.second.ino!=s->second.ino)) {
+          reset_file(d,kv.first);
+        }
+      }
+
+      // Putting back anything that was deleted (parents come first in the map)
+      std::vector<std::string> missing;
+      for (auto& kv : d.snapshot) {
+        if (current.find(kv.first)==current.end()) {
+          missing.push_back(kv.first);
+        }
+      }
+      for (auto& rel : missing) {
+        if (d.snapshot[rel].is_dir) {
+          mkdir((d.path + "/" + rel).c_str(),0777);
+          state_of(d.path + "/" + rel,d.snapshot[rel]);
+        }
+        else {
+          reset_file(d,rel);
+        }
+      }
+
+    }
+
+};
+
+/**
+ * The scoped_run_dir class acquires a case directory from a run_dir_pool
+ * and releases it when it goes out of scope.  The dtor can't throw, so an
+ * error from the reset is reported instead (the directory is then cloned
+ * again the next time it's acquired).
+ */
+
+class scoped_run_dir {
+
+  public:
+
+    explicit scoped_run_dir(run_dir_pool& pool) : pool(pool), dir(pool.acquire()) {}
+
+    ~scoped_run_dir() {
+      try {
+        pool.release(dir,manifest);
+      }
+      catch (std::exception& e) {
+        std::cerr << "WARNING: " << e.what() << std::endl;
+      }
+    }
+
+    const std::string& path() const {
+      return dir;
+    }
+
+    /**
+     * Method for recording that a file was changed, so that only the
+     * recorded files are reset on release.
+     *
+     * @param[in] rel path of the file relative to the case directory.
+     */
+    void touched(const std::string rel) {
+      manifest.push_back(rel);
+    }
+
+  private:
+
+    run_dir_pool& pool;
+    std::string dir;
+    std::vector<std::string> manifest;
+
+    scoped_run_dir(const scoped_run_dir&);
+    scoped_run_dir& operator=(const scoped_run_dir&);
+
+};
+
+#endif
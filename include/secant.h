@@ -20,6 +20,7 @@
 
 #include <fstream>
 #include <vector>
+#include "telemetry.h"
 
 /**
  * This header contains a templated function for root finding.  A variable
@@ -45,19 +46,20 @@ T secant(T x0, T tol, const unsigned int max_iter, T (*f)(T,Tn...), Tn... params
   std::vector<T> x(max_iter);
   std::vector<T> F(max_iter);
   x[0] = x0;
-  F[0] = (*f)(x0,params...);
+  F[0] = telemetry::eval(f,x0,params...);
 
   // Figuring out the first step
   // This probably isn't a good way to do it
   x[1] = 1.1*x[0];
-  F[1] = (*f)(x[1],params...);
+  F[1] = telemetry::eval(f,x[1],params...);
 
   // Iterating
   while ((fabs(F[i-1])>tol)&&(i<max_iter)) {
     x[i] = x[i-1] - F[i-1]*(x[i-1]-x[i-2])/(F[i-1]-F[i-2]);
-    F[i] = (*f)(x[i],params...);
+    F[i] = telemetry::eval(f,x[i],params...);
+    telemetry::iteration("secant",i,F[i],x[i]-x[i-1]);
 #ifdef VERBOSE
-    std::cout << "Iteration: " << i << " x = " << x[i] << " f = " << F[i] << std::endl;
+    std::cout << "Iteration: " << i << " x = " << x[i] << " f = " << F[i] << '\n';
 #endif
     ++i;
   }
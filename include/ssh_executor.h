@@ -0,0 +1,98 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SSHEXECUTORHEADERDEF
+#define SSHEXECUTORHEADERDEF
+
+#include <string>
+#include <vector>
+#include "executor.h"
+#include "remote_tools.h"
+
+/**
+ * The ssh_executor class runs cases on a remote host through an open
+ * connection.  Files are staged with put_file and fetched with get_file,
+ * and values are read on the remote host with get_remote_fields so that
+ * only the values cross the network.
+ */
+
+class ssh_executor : public executor {
+
+  public:
+
+    /**
+     * ctor
+     *
+     * @param[in] conn open connection to the host where the cases run.
+     * @param[in] work_dir remote directory in which commands run (empty means the home directory).
+     */
+    ssh_executor(connection& conn, const std::string work_dir="") : conn(conn), work_dir(work_dir) {}
+
+    void stage(const std::string local_file, const std::string dest_dir) {
+      // Creating the directory first, as local_executor does (otherwise the file would be named after it)
+      std::string dir = path_of(dest_dir);
+      if (!dir.empty()) {
+        exec_result r = conn.exec("mkdir -p " + shell_quote(dir));
+        if (r.exit_status!=0) {
+          throw remote_error("Can't create directory " + dir + ": " + r.err);
+        }
+      }
+      conn.put_file(local_file,dir);
+    }
+
+    exec_result run(const std::string cmd, const exec_options opts=exec_options()) {
+      return conn.exec(work_dir.empty() ? cmd : "cd " + shell_quote(work_dir) + " && " + cmd,opts);
+    }
+
+    void fetch(const std::string file, const std::string local_file) {
+      std::string path = path_of(file);
+      std::string::size_type slash = path.find_last_of('/');
+      std::string dir = (slash==std::string::npos) ? "." : path.substr(0,slash);
+      conn.get_file(path.substr(slash+1),dir,local_file);
+    }
+
+    std::vector<std::string> get_fields(const std::vector<remote_value>& values) {
+      std::vector<remote_value> remote(values);
+      for (auto& v : remote) {
+        v.file = path_of(v.file);
+      }
+      return conn.get_remote_fields(remote);
+    }
+
+    const void* connection_id() const {
+      return &conn;
+    }
+
+    // Only safe if no other executor uses the connection (see sweep::run)
+    void reconnect() {
+      std::string target = conn.target();
+      conn.close_connection();
+      conn.open_connection(target);
+    }
+
+  private:
+
+    connection& conn;
+    std::string work_dir;
+
+    std::string path_of(const std::string& file) const {
+      return (work_dir.empty() || file.empty() || file[0]=='/' || file[0]=='$' || file[0]=='~') ? file : work_dir + "/" + file;
+    }
+
+};
+
+#endif
@@ -20,6 +20,8 @@
 
 #include <fstream>
 #include <vector>
+#include <functional>
+#include "telemetry.h"
 #include "gss.h"
 #include "grad.h"
 
@@ -27,17 +29,18 @@
 
 /**
  * This header contains a templated function which is an implementation
- * of the steepest descent algorithm.
+ * of the steepest descent algorithm.  The gradient is found with finite
+ * differences, or taken from a gradient function (e.g., one which reads
+ * the sensitivities an adjoint solver wrote, see read_vector).
  */
 
-// Steepest descent function
+// Steepest descent with the gradient given by grad(X,F(X))
 template <typename T, typename... Tn>
-std::vector<T> steepest_descent(const std::vector<T>& X0, const T tol, const unsigned int max_iter, T (*f)(const std::vector<T>&,Tn...), Tn... params) {
+std::vector<T> steepest_descent_impl(const std::vector<T>& X0, const T tol, const unsigned int max_iter, std::function<std::vector<T>(const std::vector<T>&,T)> grad, T (*f)(const std::vector<T>&,Tn...), Tn... params) {
 
   // Declaring variables
   std::vector<T> X(X0.size());
   std::vector<T> S(X0.size());
-  std::vector<T> dX(X0.size());
   std::vector<T> Fhist;
   T alpha_opt;
   T x1d_opt, xl, xu, x1, x2, fl, fu, f1, f2;
@@ -46,75 +49,78 @@ std::vector<T> steepest_descent(const std::vector<T>& X0, const T tol, const uns
   int N;
   T F;
   X = X0;
-  F = (*f)(X0,params...);
+  F = telemetry::eval(f,X0,params...);
   Fhist.push_back(F);
 
   // Lambda functions for 1D search
   auto project = [&X,&S] (T alpha) {std::vector<T> Xn; for (int i=0; i<X.size(); ++i) Xn.push_back(X[i] + alpha*S[i]); return Xn;};   // this returns the X which corresponds to X + alpha*S
-  auto one_d_fun = [=] (T alpha) {return (*f)(project(alpha),params...); };
-
-  // Step size for finite difference calcuation of gradient
-  for (unsigned int i=0; i<X0.size(); ++i) {
-    dX[i] = X0[i]/2000.0;
-  }
+  auto one_d_fun = [=] (T alpha) {return telemetry::eval(f,project(alpha),params...); };
 
   // Iterating
   for (unsigned int i=0; i<max_iter; ++i) {
 
     // Finding gradient
-    S = grad_fdm<T>(X,F,dX,f,params...);
+    {
+      telemetry::scope timer(telemetry::phase_gradient);
+      S = grad(X,F);
+    }
+    telemetry::count(telemetry::counter_gradients);
     for (unsigned int k=0; k<S.size(); ++k) {
       S[k] *= (T) -1.0;
     }
 
     // Performing 1D search to find minimum along the direction of
     // steepest descent
-    K = 3;
-    xl = 0.0;
-    xu = 1.0;
-    fl = one_d_fun(xl);
-    fu = one_d_fun(xu);
-    x1 = (1.0 - tau)*xl + tau*xu;
-    x2 = tau*xl + (1.0 - tau)*xu;
-    f1 = one_d_fun(x1);
-    f2 = one_d_fun(x2);
-    N = (int) (ceil(log(eps)/(log(1.0 - tau)) + 3.0));
-    while (K<N) {
-      ++K;
-
-      if (f1>f2) {
-        xl = x1;
-        fl = f1;
-        x1 = x2;
-        f1 = f2;
-        x2 = tau*xl + (1.0 - tau)*xu;
-        f2 = one_d_fun(x2);
-      }
-      else {
-        xu = x2;
-        fu = f2;
-        x2 = x1;
-        f2 = f1;
-        x1 = (1.0 - tau)*xl + tau*xu;
-        f1 = one_d_fun(x1);
-      }
+    {
+      telemetry::scope search(telemetry::phase_line_search);
+      K = 3;
+      xl = 0.0;
+      xu = 1.0;
+      fl = one_d_fun(xl);
+      fu = one_d_fun(xu);
+      x1 = (1.0 - tau)*xl + tau*xu;
+      x2 = tau*xl + (1.0 - tau)*xu;
+      f1 = one_d_fun(x1);
+      f2 = one_d_fun(x2);
+      N = (int) (ceil(log(eps)/(log(1.0 - tau)) + 3.0));
+      while (K<N) {
+        ++K;
+
+        if (f1>f2) {
+          xl = x1;
+          fl = f1;
+          x1 = x2;
+          f1 = f2;
+          x2 = tau*xl + (1.0 - tau)*xu;
+          f2 = one_d_fun(x2);
+        }
+        else {
+          xu = x2;
+          fu = f2;
+          x2 = x1;
+          f2 = f1;
+          x1 = (1.0 - tau)*xl + tau*xu;
+          f1 = one_d_fun(x1);
+        }
 
+      }
+      alpha_opt = (xl + x1 + x2 + xu)/4.0;
     }
-    alpha_opt = (xl + x1 + x2 + xu)/4.0;
 
     // Updating X
     for (unsigned int j=0; j<X.size(); ++j) {
       X[j] += alpha_opt*S[j];
     }
-    F = (*f)(X,params...);
+    F = telemetry::eval(f,X,params...);
     Fhist.push_back(F);
+    telemetry::iteration("steepest_descent",i,F,alpha_opt);
 
 #ifdef VERBOSE
     std::cout << "iteration: " << i << " ";
     for (auto val : X) {
       std::cout << val << " ";
     }
-    std::cout << std::endl;
+    std::cout << '\n';
 #endif 
 
     // Checking tolerance
@@ -128,4 +134,31 @@ std::vector<T> steepest_descent(const std::vector<T>& X0, const T tol, const uns
 
 }
 
+// Steepest descent function
+template <typename T, typename... Tn>
+std::vector<T> steepest_descent(const std::vector<T>& X0, const T tol, const unsigned int max_iter, T (*f)(const std::vector<T>&,Tn...), Tn... params) {
+
+  // Step size for finite difference calcuation of gradient
+  std::vector<T> dX(X0.size());
+  for (unsigned int i=0; i<X0.size(); ++i) {
+    dX[i] = X0[i]/2000.0;
+  }
+
+  auto fdm = [=] (const std::vector<T>& X, T F) {return grad_fdm<T>(X,F,dX,f,params...);};
+  return steepest_descent_impl<T,Tn...>(X0,tol,max_iter,fdm,f,params...);
+
+}
+
+// Steepest descent function which gets the gradient from g instead of
+// N finite difference evaluations.  g is always called right after f was
+// evaluated at the same X, so it can read what the solver wrote in that
+// run (e.g., an adjoint gradient, see read_vector).
+template <typename T, typename... Tn>
+std::vector<T> steepest_descent(const std::vector<T>& X0, const T tol, const unsigned int max_iter, T (*f)(const std::vector<T>&,Tn...), std::vector<T> (*g)(const std::vector<T>&,Tn...), Tn... params) {
+
+  auto provided = [=] (const std::vector<T>& X, T) {return (*g)(X,params...);};
+  return steepest_descent_impl<T,Tn...>(X0,tol,max_iter,provided,f,params...);
+
+}
+
 #endif
@@ -0,0 +1,672 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SWEEPHEADERDEF
+#define SWEEPHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <set>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+#include "errors.h"
+#include "file_ops.h"
+#include "replace_string.h"
+#include "executor.h"
+
+/**
+ * A parameter of a sweep.  name is both the column name in the results
+ * and the variable which is replaced in the input deck.  levels is only
+ * used by full_factorial.
+ */
+struct sweep_param {
+  std::string name;
+  double lo;
+  double hi;
+  unsigned int levels;
+  sweep_param(const std::string name, const double lo, const double hi, const unsigned int levels=2) : name(name), lo(lo), hi(hi), levels(levels) {}
+};
+
+/**
+ * The points of a sweep, stored by column (columns[j][i] is parameter j
+ * of point i).
+ */
+struct sweep_design {
+  std::vector<std::string> names;
+  std::vector<std::vector<double> > columns;
+  std::size_t size() const {
+    return columns.empty() ? 0 : columns[0].size();
+  }
+};
+
+enum point_status {point_pending, point_done, point_failed};
+
+/**
+ * The results of a sweep, stored by column.  The inputs come first, then
+ * the outputs.  Outputs of points which failed are NaN.
+ */
+struct sweep_table {
+
+  std::vector<std::string> names;
+  std::vector<std::vector<double> > columns;
+  std::vector<unsigned char> status;
+
+  std::size_t size() const {
+    return status.size();
+  }
+
+  /**
+   * Method for getting a column by name.
+   */
+  const std::vector<double>& column(const std::string& name) const {
+    for (std::size_t j=0; j<names.size(); ++j) {
+      if (names[j]==name) {
+        return columns[j];
+      }
+    }
+    throw cppopt_error("No column named " + name + " in the sweep results.");
+  }
+
+  /**
+   * Method for writing the table as whitespace-separated columns, with
+   * the names on a commented header line and the status as the last
+   * column (1 is done, 2 is failed).
+   */
+  void write(const std::string filename) const {
+    atomic_file_writer out(filename,durability_none);
+    std::string line = "#";
+    for (auto& name : names) {
+      line += " " + name;
+    }
+    line += " status\n";
+    out.write(line);
+    char buf[32];
+    for (std::size_t i=0; i<size(); ++i) {
+      line.clear();
+      for (auto& c : columns) {
+        snprintf(buf,sizeof(buf),"%.10g ",c[i]);
+        line += buf;
+      }
+      line += static_cast<char>('0'+status[i]);
+      line += '\n';
+      out.write(line);
+    }
+    out.commit();
+  }
+
+};
+
+/**
+ * Maps points in the unit cube to the ranges of the parameters.
+ */
+inline sweep_design scale_design(const std::vector<sweep_param>& params, std::vector<std::vector<double> > unit) {
+  sweep_design design;
+  for (std::size_t j=0; j<params.size(); ++j) {
+    design.names.push_back(params[j].name);
+    for (auto& u : unit[j]) {
+      u = params[j].lo + u*(params[j].hi-params[j].lo);
+    }
+  }
+  design.columns.swap(unit);
+  return design;
+}
+
+/**
+ * Function for making a full factorial design.  Each parameter takes
+ * levels evenly spaced values from lo to hi (a single level is lo), and
+ * the last parameter varies fastest.
+ *
+ * @param[in] params the parameters.
+ * @return The design.
+ */
+inline sweep_design full_factorial(const std::vector<sweep_param>& params) {
+  std::size_t n = params.empty() ? 0 : 1;
+  for (auto& p : params) {
+    n *= std::max(p.levels,1u);
+  }
+  std::vector<std::vector<double> > unit(params.size(),std::vector<double>(n));
+  std::size_t stride = 1;
+  for (std::size_t j=params.size(); j-->0; ) {
+    unsigned int levels = std::max(params[j].levels,1u);
+    for (std::size_t i=0; i<n; ++i) {
+      unsigned int k = (i/stride) % levels;
+      unit[j][i] = (levels==1) ? 0.0 : static_cast<double>(k)/(levels-1);
+    }
+    stride *= levels;
+  }
+  return scale_design(params,unit);
+}
+
+/**
+ * Function for making a Latin hypercube design.  The range of each
+ * parameter is cut into n equal strata, each stratum is used by exactly
+ * one point, and the point is placed at random within it.
+ *
+ * @param[in] params the parameters.
+ * @param[in] n number of points.
+ * @param[in] seed seed of the random number generator.
+ * @return The design.
+ */
+inline sweep_design latin_hypercube(const std::vector<sweep_param>& params, const std::size_t n, const unsigned int seed=1) {
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> uniform(0.0,1.0);
+  std::vector<std::vector<double> > unit(params.size(),std::vector<double>(n));
+  std::vector<std::size_t> perm(n);
+  for (std::size_t j=0; j<params.size(); ++j) {
+    for (std::size_t i=0; i<n; ++i) {
+      perm[i] = i;
+    }
+    std::shuffle(perm.begin(),perm.end(),rng);
+    for (std::size_t i=0; i<n; ++i) {
+      unit[j][i] = (perm[i] + uniform(rng))/n;
+    }
+  }
+  return scale_design(params,unit);
+}
+
+/**
+ * Function for making a Sobol design (a low discrepancy sequence, which
+ * fills the space more evenly than random points and can be extended
+ * later by asking for more points).  Uses the Joe and Kuo direction
+ * numbers and Gray code ordering.  Up to 16 parameters are supported.
+ *
+ * @param[in] params the parameters.
+ * @param[in] n number of points.
+ * @param[in] skip number of points at the start of the sequence which are skipped.
+ * @return The design.
+ */
+inline sweep_design sobol_design(const std::vector<sweep_param>& params, const std::size_t n, const std::size_t skip=0) {
+
+  // Degree, polynomial coefficients and initial direction numbers of dimensions 2 to 16
+  static const unsigned int s[15] = {1, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5, 5, 6, 6, 6};
+  static const unsigned int a[15] = {0, 1, 1, 2, 1, 4, 2, 4, 7, 11, 13, 14, 1, 13, 16};
+  static const unsigned int m[15][6] = {
+    {1}, {1,3}, {1,3,1}, {1,1,1}, {1,1,3,3}, {1,3,5,13}, {1,1,5,5,17}, {1,1,5,5,5},
+    {1,1,7,11,19}, {1,1,5,1,1}, {1,1,1,3,11}, {1,3,5,5,31}, {1,3,3,9,7,49},
+    {1,1,1,15,21,21}, {1,3,1,13,27,49} };
+
+  if (params.size()>16) {
+    std::ostringstream msg;
+    msg << "sobol_design supports up to 16 parameters (" << params.size() << " given).";
+    throw cppopt_error(msg.str());
+  }
+
+  const double scale = 1.0/4294967296.0;
+  std::vector<std::vector<double> > unit(params.size(),std::vector<double>(n));
+  for (std::size_t j=0; j<params.size(); ++j) {
+
+    // Direction numbers, scaled by 2^32
+    uint32_t v[33];
+    if (j==0) {
+      for (unsigned int i=1; i<=32; ++i) {
+        v[i] = 1u << (32-i);
+      }
+    }
+    else {
+      unsigned int d = s[j-1];
+      for (unsigned int i=1; i<=d; ++i) {
+        v[i] = m[j-1][i-1] << (32-i);
+      }
+      for (unsigned int i=d+1; i<=32; ++i) {
+        v[i] = v[i-d] ^ (v[i-d] >> d);
+        for (unsigned int k=1; k<d; ++k) {
+          v[i] ^= ((a[j-1] >> (d-1-k)) & 1u)*v[i-k];
+        }
+      }
+    }
+
+    // Each point differs from the previous one in one direction number
+    uint32_t x = 0;
+    for (std::size_t i=0; i<skip+n; ++i) {
+      if (i>=skip) {
+        unit[j][i-skip] = x*scale;
+      }
+      unsigned int c = 1;
+      for (std::size_t value=i; value & 1; value >>= 1) {
+        ++c;
+      }
+      x ^= v[c];
+    }
+
+  }
+
+  return scale_design(params,unit);
+
+}
+
+/**
+ * The sweep class runs every point of a design through a solver and
+ * collects the results.  For each point, the input deck is rendered with
+ * the values of the parameters and piped to the command's stdin (or
+ * written to deck_file in the work directory first), and the outputs are
+ * read from stdout or from the files the command wrote.
+ *
+ * Points run concurrently, one per executor, so each executor should
+ * have its own work directory (e.g., directories from a run_dir_pool, or
+ * ssh_executors on several hosts).  A point fails if the command exits
+ * with a nonzero status or an output can't be read, and transient remote
+ * errors are retried (see with_retry) after reconnecting the executor.
+ * Since a reconnect closes the executor's connection, each ssh_executor
+ * needs a connection of its own; run() throws if two workers share one.
+ *
+ * If a journal is set, every finished point is appended to it as it
+ * completes.  Running the same sweep with the same journal again skips
+ * the points which are already in it, so an interrupted sweep picks up
+ * where it stopped.
+ *
+ * Usage: sweep s(input_deck("deck.in"),"./solver",outputs,{"cd","cl"});
+ *        s.set_journal("sweep.journal");
+ *        sweep_table t = s.run(latin_hypercube(params,100000),workers);
+ *        t.write("sweep.dat");
+ */
+
+class sweep {
+
+  public:
+
+    /**
+     * ctor
+     *
+     * @param[in] deck template of the input deck (the parameter names are replaced).
+     * @param[in] cmd command which runs the solver.
+     * @param[in] outputs where the outputs are found.  Outputs whose file is empty are read from stdout.
+     * @param[in] output_names column names of the outputs.
+     */
+    sweep(const input_deck& deck, const std::string cmd, const std::vector<remote_value>& outputs, const std::vector<std::string>& output_names) : deck(deck), cmd(cmd), outputs(outputs), output_names(output_names), retry_failed(false) {
+      if (outputs.size()!=output_names.size()) {
+        throw cppopt_error("The sweep needs one name per output.");
+      }
+      for (std::size_t k=0; k<outputs.size(); ++k) {
+        if (outputs[k].file.empty()) {
+          stdout_outputs.push_back(k);
+        }
+        else {
+          file_outputs.push_back(k);
+          file_values.push_back(outputs[k]);
+        }
+      }
+    }
+
+    /**
+     * Method for writing the deck to a file in the work directory instead
+     * of piping it to the command.
+     */
+    void set_deck_file(const std::string filename) {
+      deck_file = filename;
+    }
+
+    /**
+     * Method for setting the journal which makes the sweep resumable.
+     *
+     * @param[in] filename journal file (created if it doesn't exist).
+     * @param[in] retry_failed if true, points which failed before are run again.
+     */
+    void set_journal(const std::string filename, const bool retry_failed=false) {
+      journal_name = filename;
+      this->retry_failed = retry_failed;
+    }
+
+    /**
+     * Method for setting the options of every command (e.g., a timeout).
+     */
+    void set_options(const exec_options opts) {
+      options = opts;
+    }
+
+    /**
+     * Method for running the sweep.
+     *
+     * @param[in] design the points.
+     * @param[in] workers one executor per point which may run at once.
+     * @return The inputs and outputs of every point.
+     */
+    sweep_table run(const sweep_design& design, const std::vector<executor*> workers) {
+
+      if (workers.empty()) {
+        throw cppopt_error("The sweep needs at least one executor.");
+      }
+      std::set<const void*> connections;
+      for (auto ex : workers) {
+        const void* id = ex->connection_id();
+        if (id!=NULL && !connections.insert(id).second) {
+          throw cppopt_error("Two of the sweep's executors share a connection; each needs its own.");
+        }
+      }
+
+      this->design = &design;
+      table.names = design.names;
+      table.names.insert(table.names.end(),output_names.begin(),output_names.end());
+      table.columns = design.columns;
+      table.columns.resize(table.names.size(),std::vector<double>(design.size(),std::numeric_limits<double>::quiet_NaN()));
+      table.status.assign(design.size(),point_pending);
+
+      // Finding the points which are left
+      journal_fd = -1;
+      if (!journal_name.empty()) {
+        read_journal();
+      }
+      todo.clear();
+      for (std::size_t i=0; i<design.size(); ++i) {
+        if (table.status[i]==point_pending || (retry_failed && table.status[i]==point_failed)) {
+          todo.push_back(i);
+        }
+      }
+#ifdef VERBOSE
+      if (todo.size()<design.size()) {
+        std::cout << "Resuming sweep: " << design.size()-todo.size() << " of " << design.size() << " points already done." << std::endl;
+      }
+#endif
+
+      next = 0;
+      nfinished = 0;
+      nfailed = 0;
+      stop = false;
+      error = nullptr;
+      std::vector<std::thread> threads;
+      for (auto ex : workers) {
+        threads.push_back(std::thread(&sweep::work,this,ex));
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+      if (journal_fd>=0) {
+        close(journal_fd);
+      }
+      if (error) {
+        std::rethrow_exception(error);
+      }
+
+      if (nfailed>0) {
+        std::cerr << "\nWARNING: " << nfailed << " of " << todo.size() << " sweep points failed." << std::endl;
+      }
+
+      return table;
+
+    }
+
+  private:
+
+    input_deck deck;
+    std::string cmd;
+    std::vector<remote_value> outputs;
+    std::vector<std::string> output_names;
+    std::vector<std::size_t> stdout_outputs;
+    std::vector<std::size_t> file_outputs;
+    std::vector<remote_value> file_values;
+    std::string deck_file;
+    std::string journal_name;
+    bool retry_failed;
+    exec_options options;
+
+    const sweep_design* design;
+    sweep_table table;
+    std::vector<std::size_t> todo;
+    std::atomic<std::size_t> next;
+    std::atomic<std::size_t> nfinished;
+    std::atomic<std::size_t> nfailed;
+    std::atomic<bool> stop;
+    std::exception_ptr error;
+    int journal_fd;
+    std::mutex mtx;
+
+    // Identifies the sweep, so that a journal isn't used for a different one
+    std::string journal_header() const {
+      std::ostringstream header;
+      header << "# sweep of " << design->size() << " points, inputs";
+      for (auto& name : design->names) {
+        header << " " << name;
+      }
+      header << ", outputs";
+      for (auto& name : output_names) {
+        header << " " << name;
+      }
+      return header.str();
+    }
+
+    // Loads the points which are in the journal and opens it for appending
+    void read_journal() {
+
+      std::string header = journal_header();
+      std::ifstream infile(journal_name.c_str());
+      bool exists = infile.is_open();
+      if (exists) {
+        std::string line;
+        if (std::getline(infile,line) && line!=header) {
+          std::ostringstream msg;
+          msg << "Journal " << journal_name << " belongs to a different sweep (" << line << ").";
+          throw file_error(msg.str());
+        }
+        while (std::getline(infile,line)) {
+          // Each line is: index status output...  A cut-off last line is ignored.
+          std::istringstream fields(line);
+          std::size_t i;
+          int st;
+          if (!(fields >> i >> st) || i>=design->size() || (st!=point_done && st!=point_failed)) {
+            continue;
+          }
+          std::vector<double> out(outputs.size());
+          std::string word;
+          std::size_t k = 0;
+          while (k<out.size() && fields >> word) {
+            out[k++] = strtod(word.c_str(),NULL);
+          }
+          if (k<out.size()) {
+            continue;
+          }
+          for (k=0; k<out.size(); ++k) {
+            table.columns[design->names.size()+k][i] = out[k];
+          }
+          table.status[i] = st;
+        }
+        infile.close();
+      }
+
+      journal_fd = open(journal_name.c_str(),O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,0644);
+      if (journal_fd<0) {
+        std::ostringstream msg;
+        msg << "Can't open journal " << journal_name << ": " << strerror(errno);
+        throw file_error(msg.str());
+      }
+      if (!exists) {
+        append(header + "\n");
+      }
+
+    }
+
+    void append(const std::string& line) {
+      const char* p = line.data();
+      std::size_t left = line.size();
+      while (left>0) {
+        ssize_t n = ::write(journal_fd,p,left);
+        if (n<0) {
+          if (errno==EINTR) {
+            continue;
+          }
+          std::ostringstream msg;
+          msg << "Can't write to journal " << journal_name << ": " << strerror(errno);
+          throw file_error(msg.str());
+        }
+        p += n;
+        left -= n;
+      }
+    }
+
+    // Runs one point, returns false if it failed
+    bool evaluate(executor& ex, const input_deck& d, const std::size_t i, std::vector<double>& out) {
+
+      exec_options opts = options;
+      opts.input = d.render();
+      std::string full_cmd = deck_file.empty() ? cmd : "cat > " + shell_quote(deck_file) + " && " + cmd;
+
+      // A transient error usually means the connection dropped, so it's reopened before retrying
+      auto reconnect = [&ex] (const remote_error&, unsigned int) {
+        try {
+          ex.reconnect();
+        }
+        catch (const cppopt_error&) {
+          // The next attempt fails and tries again
+        }
+      };
+
+      try {
+
+        exec_result r = with_retry([&ex,&full_cmd,&opts] () {return ex.run(full_cmd,opts);},retry_policy(),reconnect);
+        if (r.exit_status!=0) {
+          report(i,r.timed_out ? "timed out" : "exit status " + std::to_string(r.exit_status));
+          return false;
+        }
+
+        for (auto k : stdout_outputs) {
+          out[k] = boost::lexical_cast<double>(field_of(r.out,outputs[k]));
+        }
+        if (!file_values.empty()) {
+          std::vector<std::string> fields = with_retry([&ex,this] () {return ex.get_fields(file_values);},retry_policy(),reconnect);
+          for (std::size_t k=0; k<file_outputs.size(); ++k) {
+            out[file_outputs[k]] = boost::lexical_cast<double>(fields[k]);
+          }
+        }
+
+      }
+      catch (const cppopt_error& e) {
+        report(i,e.what());
+        return false;
+      }
+      catch (const boost::bad_lexical_cast&) {
+        report(i,"an output isn't a number");
+        return false;
+      }
+
+      return true;
+
+    }
+
+    // Finds a field in a command's output (same conventions as remote_value)
+    static std::string field_of(const std::string& text, const remote_value& v) {
+      std::istringstream in(text);
+      std::string line;
+      unsigned int n = 0;
+      while (std::getline(in,line)) {
+        std::istringstream fields(line);
+        std::vector<std::string> words;
+        std::string word;
+        bool wanted = v.label.empty() ? (n==v.line_num) : (fields >> word && word==v.label);
+        ++n;
+        if (!wanted) {
+          continue;
+        }
+        if (!v.label.empty()) {
+          words.push_back(word);
+        }
+        while (fields >> word) {
+          words.push_back(word);
+        }
+        if (v.pos<words.size()) {
+          return words[v.pos];
+        }
+        break;
+      }
+      std::ostringstream msg;
+      msg << "Didn't find field " << v.pos << " of ";
+      if (v.label.empty()) {
+        msg << "line " << v.line_num;
+      }
+      else {
+        msg << "the line labeled " << v.label;
+      }
+      msg << " in the output.";
+      throw parse_error(msg.str());
+    }
+
+    // Only the first few failures are printed, the rest are counted
+    void report(const std::size_t i, const std::string& why) {
+      if (nfailed.fetch_add(1)<10) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::cerr << "\nWARNING: Sweep point " << i << " failed: " << why << std::endl;
+      }
+    }
+
+    void work(executor* ex) {
+
+      input_deck d = deck;
+      std::vector<double> out(outputs.size());
+      std::size_t np = design->names.size();
+      char buf[32];
+
+      try {
+        for (std::size_t k=next++; k<todo.size() && !stop; k=next++) {
+
+          std::size_t i = todo[k];
+          for (std::size_t j=0; j<np; ++j) {
+            snprintf(buf,sizeof(buf),"%.12g",design->columns[j][i]);
+            d.set(design->names[j],std::string(buf));
+          }
+
+          bool ok = evaluate(*ex,d,i,out);
+
+          // Points are written to different rows, so the table isn't locked
+          table.status[i] = ok ? point_done : point_failed;
+          std::string line = std::to_string(i) + " " + std::to_string(table.status[i]);
+          for (std::size_t m=0; m<out.size(); ++m) {
+            double value = ok ? out[m] : std::numeric_limits<double>::quiet_NaN();
+            table.columns[np+m][i] = value;
+            snprintf(buf,sizeof(buf)," %.17g",value);
+            line += buf;
+          }
+          line += '\n';
+
+          if (journal_fd>=0) {
+            std::lock_guard<std::mutex> lock(mtx);
+            append(line);
+          }
+
+#ifdef VERBOSE
+          std::size_t nf = ++nfinished;
+          if (nf % std::max<std::size_t>(todo.size()/20,1)==0) {
+            std::lock_guard<std::mutex> lock(mtx);
+            std::cout << "Sweep: " << nf << " of " << todo.size() << " points done." << std::endl;
+          }
+#endif
+
+        }
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!error) {
+          error = std::current_exception();
+        }
+        stop = true;
+      }
+
+    }
+
+};
+
+#endif
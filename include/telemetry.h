@@ -0,0 +1,404 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TELEMETRYHEADERDEF
+#define TELEMETRYHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/**
+ * The telemetry class records what the optimizers and transfers are
+ * doing, and is switched on at run time (telemetry::enable, or the
+ * environment variable CPPOPT_TELEMETRY=1) instead of with -DVERBOSE.
+ * When it's off, each instrumented spot costs one relaxed atomic load.
+ *
+ * Three kinds of data are kept:
+ *
+ *   - counters (evaluations, gradients, iterations, bytes moved),
+ *   - the total time spent in each phase (evaluation, gradient, line
+ *     search, transfer),
+ *   - events: every phase and every iteration (with f and the step
+ *     size), written to a fixed size lock-free ring buffer which keeps
+ *     the newest events.  The ring is allocated the first time telemetry
+ *     is switched on and is never freed or resized, since other threads
+ *     may be writing to it at any time.  An event whose slot is still
+ *     being written by another thread (only possible once the ring has
+ *     wrapped) is dropped.
+ *
+ * The events can be written as a Chrome trace (open it in
+ * chrome://tracing or https://ui.perfetto.dev) or as CSV.  Events which
+ * are being written while they're exported are skipped, so export after
+ * the run.
+ *
+ * Usage: telemetry::enable();
+ *        x = steepest_descent(x0,tol,max_iter,&f);
+ *        telemetry::report(std::cout);
+ *        telemetry::write_chrome_trace("trace.json");
+ */
+
+class telemetry {
+
+  public:
+
+    enum phase {phase_evaluation, phase_gradient, phase_line_search, phase_transfer, nphases};
+    enum counter {counter_evaluations, counter_gradients, counter_iterations, counter_bytes_sent, counter_bytes_received, ncounters};
+
+    /**
+     * Method for switching telemetry on or off.
+     *
+     * @param[in] on true to record.
+     * @param[in] capacity number of events kept in the ring buffer (rounded up to a power of 2).
+     *                     Only the first call which switches telemetry on sets it.
+     */
+    static void enable(const bool on=true, const std::size_t capacity=65536) {
+      state& s = get();
+      if (on) {
+        allocate(s,capacity);
+      }
+      s.on.store(on);
+    }
+
+    static bool enabled() {
+      return get().on.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Method for clearing the counters, phase times and events.
+     */
+    static void reset() {
+      state& s = get();
+      for (auto& c : s.counters) {
+        c.store(0);
+      }
+      for (int p=0; p<nphases; ++p) {
+        s.phase_ns[p].store(0);
+        s.phase_calls[p].store(0);
+      }
+      event* ring = s.ring.load(std::memory_order_acquire);
+      for (std::size_t i=0; ring!=NULL && i<s.capacity; ++i) {
+        ring[i].seq.store(0);
+      }
+      s.head.store(0);
+    }
+
+    static void count(const counter c, const uint64_t n=1) {
+      state& s = get();
+      if (s.on.load(std::memory_order_relaxed)) {
+        s.counters[c].fetch_add(n,std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * Method for recording an iteration of an optimizer.
+     *
+     * @param[in] optimizer name of the optimizer (must be a string literal).
+     * @param[in] iter iteration number.
+     * @param[in] f objective function after the iteration.
+     * @param[in] step size of the step which was taken.
+     */
+    static void iteration(const char* optimizer, const unsigned int iter, const double f, const double step=0.0) {
+      state& s = get();
+      if (!s.on.load(std::memory_order_relaxed)) {
+        return;
+      }
+      s.counters[counter_iterations].fetch_add(1,std::memory_order_relaxed);
+      record(s,kind_iteration,0,optimizer,now_ns(s),0,iter,f,step);
+    }
+
+    /**
+     * The scope class times a phase from its construction to the end of
+     * the enclosing block.
+     */
+    class scope {
+      public:
+        explicit scope(const phase p, const char* name=NULL) : p(p), name(name), start(-1) {
+          if (enabled()) {
+            start = now_ns(get());
+          }
+        }
+        ~scope() {
+          if (start>=0) {
+            state& s = get();
+            int64_t dur = now_ns(s) - start;
+            s.phase_ns[p].fetch_add(dur,std::memory_order_relaxed);
+            s.phase_calls[p].fetch_add(1,std::memory_order_relaxed);
+            record(s,kind_phase,p,(name!=NULL) ? name : phase_name(p),start,dur,0,0.0,0.0);
+          }
+        }
+      private:
+        phase p;
+        const char* name;
+        int64_t start;
+        scope(const scope&);
+        scope& operator=(const scope&);
+    };
+
+    /**
+     * Method for calling an objective function, counting and timing the
+     * evaluation.
+     */
+    template <typename F, typename... A>
+    static auto eval(F f, A&&... args) -> decltype(f(std::forward<A>(args)...)) {
+      scope timer(phase_evaluation);
+      count(counter_evaluations);
+      return f(std::forward<A>(args)...);
+    }
+
+    static uint64_t value(const counter c) {
+      return get().counters[c].load();
+    }
+
+    static double seconds(const phase p) {
+      return 1.0e-9*get().phase_ns[p].load();
+    }
+
+    /**
+     * Method for printing the counters and phase times.
+     */
+    static void report(std::ostream& out) {
+      state& s = get();
+      const char* counter_names[ncounters] = {"evaluations", "gradients", "iterations", "bytes sent", "bytes received"};
+      out << "Telemetry:\n";
+      for (int c=0; c<ncounters; ++c) {
+        out << "  " << counter_names[c] << ": " << s.counters[c].load() << '\n';
+      }
+      for (int p=0; p<nphases; ++p) {
+        uint64_t calls = s.phase_calls[p].load();
+        out << "  " << phase_name(static_cast<phase>(p)) << ": " << calls << " in " << 1.0e-9*s.phase_ns[p].load() << " s";
+        if (calls>0) {
+          out << " (" << 1.0e-3*s.phase_ns[p].load()/calls << " us each)";
+        }
+        out << '\n';
+      }
+      out.flush();
+    }
+
+    /**
+     * Method for writing the events in the Chrome trace event format.
+     * Phases are complete events ("X") on the thread which ran them and
+     * iterations are counters ("C") of f, one track per optimizer.
+     */
+    static void write_chrome_trace(const std::string filename) {
+      std::ofstream out(filename.c_str());
+      out << "{\"traceEvents\":[";
+      bool first = true;
+      char buf[512];
+      for_each_event([&] (const event& e) {
+        if (e.kind==kind_phase) {
+          snprintf(buf,sizeof(buf),"%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                   first ? "" : ",",e.name,phase_name(static_cast<phase>(e.phase)),e.tid,1.0e-3*e.start_ns,1.0e-3*e.dur_ns);
+        }
+        else {
+          snprintf(buf,sizeof(buf),"%s\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"f\":%.17g,\"step\":%.17g}}",
+                   first ? "" : ",",e.name,1.0e-3*e.start_ns,finite_or_zero(e.f),finite_or_zero(e.step));
+        }
+        out << buf;
+        first = false;
+      });
+      out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    /**
+     * Method for writing the events as CSV, one row per event.
+     */
+    static void write_csv(const std::string filename) {
+      std::ofstream out(filename.c_str());
+      out << "kind,name,thread,start_us,duration_us,iteration,f,step\n";
+      char buf[512];
+      for_each_event([&] (const event& e) {
+        if (e.kind==kind_phase) {
+          snprintf(buf,sizeof(buf),"phase,%s,%u,%.3f,%.3f,,,\n",e.name,e.tid,1.0e-3*e.start_ns,1.0e-3*e.dur_ns);
+        }
+        else {
+          snprintf(buf,sizeof(buf),"iteration,%s,%u,%.3f,,%u,%.17g,%.17g\n",e.name,e.tid,1.0e-3*e.start_ns,e.iter,e.f,e.step);
+        }
+        out << buf;
+      });
+    }
+
+    static const char* phase_name(const phase p) {
+      const char* names[nphases] = {"evaluation", "gradient", "line search", "transfer"};
+      return names[p];
+    }
+
+  private:
+
+    enum kind {kind_phase, kind_iteration};
+
+    // seq is the event's position in the stream plus one, and 0 while it's
+    // being written.  busy is held by the writer which owns the slot.
+    struct event {
+      std::atomic<uint64_t> seq;
+      std::atomic<bool> busy;
+      unsigned char kind;
+      unsigned char phase;
+      uint32_t tid;
+      const char* name;
+      int64_t start_ns;
+      int64_t dur_ns;
+      uint32_t iter;
+      double f;
+      double step;
+      event() : seq(0), busy(false) {}
+    };
+
+    struct state {
+      std::atomic<bool> on;
+      std::atomic<uint64_t> counters[ncounters];
+      std::atomic<int64_t> phase_ns[nphases];
+      std::atomic<uint64_t> phase_calls[nphases];
+      std::unique_ptr<event[]> storage;
+      std::atomic<event*> ring;
+      std::size_t capacity;
+      std::mutex alloc_mtx;
+      std::atomic<uint64_t> head;
+      std::atomic<uint32_t> next_tid;
+      std::chrono::steady_clock::time_point epoch;
+      state() : ring(NULL), capacity(0), head(0), next_tid(0), epoch(std::chrono::steady_clock::now()) {
+        on.store(false);
+        for (auto& c : counters) {
+          c.store(0);
+        }
+        for (int p=0; p<nphases; ++p) {
+          phase_ns[p].store(0);
+          phase_calls[p].store(0);
+        }
+      }
+    };
+
+    static state& get() {
+      static state s;
+      static bool from_env = init_from_env(s);
+      (void) from_env;
+      return s;
+    }
+
+    static bool init_from_env(state& s) {
+      const char* env = getenv("CPPOPT_TELEMETRY");
+      if (env!=NULL && strcmp(env,"0")!=0 && env[0]!='\0') {
+        allocate(s,65536);
+        s.on.store(true);
+      }
+      return true;
+    }
+
+    // Allocates the ring the first time (capacity is set before the ring is published)
+    static void allocate(state& s, const std::size_t capacity) {
+      std::lock_guard<std::mutex> lock(s.alloc_mtx);
+      if (s.ring.load(std::memory_order_acquire)!=NULL) {
+        return;
+      }
+      std::size_t n = 1;
+      while (n<capacity) {
+        n <<= 1;
+      }
+      s.storage.reset(new event[n]);
+      s.capacity = n;
+      s.ring.store(s.storage.get(),std::memory_order_release);
+    }
+
+    static int64_t now_ns(const state& s) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-s.epoch).count();
+    }
+
+    static uint32_t thread_id(state& s) {
+      static thread_local uint32_t id = s.next_tid.fetch_add(1);
+      return id;
+    }
+
+    static double finite_or_zero(const double x) {
+      return (x-x==0.0) ? x : 0.0;
+    }
+
+    // Claims the next slot, overwriting the oldest event when the ring is full
+    static void record(state& s, const kind k, const int p, const char* name, const int64_t start, const int64_t dur, const unsigned int iter, const double f, const double step) {
+      event* ring = s.ring.load(std::memory_order_acquire);
+      if (ring==NULL) {
+        return;
+      }
+      uint64_t idx = s.head.fetch_add(1,std::memory_order_relaxed);
+      event& e = ring[idx & (s.capacity-1)];
+      // Dropping the event if another writer has the slot, or a newer event is already in it
+      if (e.busy.exchange(true,std::memory_order_acquire)) {
+        return;
+      }
+      if (e.seq.load(std::memory_order_relaxed)>idx+1) {
+        e.busy.store(false,std::memory_order_release);
+        return;
+      }
+      e.seq.store(0,std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      e.kind = static_cast<unsigned char>(k);
+      e.phase = static_cast<unsigned char>(p);
+      e.tid = thread_id(s);
+      e.name = name;
+      e.start_ns = start;
+      e.dur_ns = dur;
+      e.iter = iter;
+      e.f = f;
+      e.step = step;
+      e.seq.store(idx+1,std::memory_order_release);
+      e.busy.store(false,std::memory_order_release);
+    }
+
+    // Calls fn with a copy of every complete event, oldest first
+    template <typename Fn>
+    static void for_each_event(Fn fn) {
+      state& s = get();
+      event* ring = s.ring.load(std::memory_order_acquire);
+      if (ring==NULL) {
+        return;
+      }
+      uint64_t head = s.head.load(std::memory_order_acquire);
+      uint64_t first = (head>s.capacity) ? head-s.capacity : 0;
+      for (uint64_t idx=first; idx<head; ++idx) {
+        const event& slot = ring[idx & (s.capacity-1)];
+        if (slot.seq.load(std::memory_order_acquire)!=idx+1) {
+          continue;
+        }
+        event copy;
+        copy.kind = slot.kind;
+        copy.phase = slot.phase;
+        copy.tid = slot.tid;
+        copy.name = slot.name;
+        copy.start_ns = slot.start_ns;
+        copy.dur_ns = slot.dur_ns;
+        copy.iter = slot.iter;
+        copy.f = slot.f;
+        copy.step = slot.step;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed)!=idx+1) {
+          continue;
+        }
+        fn(copy);
+      }
+    }
+
+};
+
+#endif
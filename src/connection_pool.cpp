@@ -0,0 +1,179 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include "connection_pool.h"
+
+/**
+ * ctor
+ */
+
+pooled_connection::pooled_connection(connection_pool* pool, const std::string target, connection* conn) : pool(pool), target(target), conn(conn) {}
+
+/**
+ * move ctor
+ */
+
+pooled_connection::pooled_connection(pooled_connection&& other) : pool(other.pool), target(other.target), conn(other.conn) {
+  other.conn = NULL;
+}
+
+/**
+ * dtor which returns the connection to the pool.
+ */
+
+pooled_connection::~pooled_connection() {
+  if (conn!=NULL) {
+    pool->checkin(target,conn);
+  }
+}
+
+connection* pooled_connection::operator->() const {
+  return conn;
+}
+
+connection& pooled_connection::operator*() const {
+  return *conn;
+}
+
+/**
+ * ctor which starts the keepalive thread.
+ *
+ * @param[in] sessions_per_host maximum number of sessions opened to each host.
+ * @param[in] keepalive_s interval between keepalives on idle sessions, in seconds (0 disables them).
+ */
+
+connection_pool::connection_pool(const unsigned int sessions_per_host, const unsigned int keepalive_s) {
+  max_sessions = (sessions_per_host>0) ? sessions_per_host : 1;
+  keepalive_interval = keepalive_s;
+  running = true;
+  if (keepalive_interval>0) {
+    keepalive_thread = std::thread(&connection_pool::keepalive_loop,this);
+  }
+}
+
+/**
+ * dtor which stops the keepalive thread.  The sessions are closed by the
+ * connection dtors.
+ */
+
+connection_pool::~connection_pool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    running = false;
+  }
+  stopping.notify_all();
+  if (keepalive_thread.joinable()) {
+    keepalive_thread.join();
+  }
+}
+
+/**
+ * Method for checking out a connection to a host.
+ *
+ * @param[in] target hostname and username (eg, grisham@cfdlab.uta.edu)
+ * @returns a handle which gives access to the connection.
+ */
+
+pooled_connection connection_pool::checkout(const std::string target) {
+
+  connection* conn = NULL;
+  bool needs_open = false;
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    host_sessions& h = hosts[target];
+    available.wait(lock,[&h,this] () {return !h.idle.empty() || h.all.size()<max_sessions;});
+    if (!h.idle.empty()) {
+      conn = h.idle.back();
+      h.idle.pop_back();
+    }
+    else {
+      h.all.push_back(std::unique_ptr<connection>(new connection()));
+      conn = h.all.back().get();
+    }
+    needs_open = !conn->is_open();
+  }
+
+  // Handshakes are done without holding the lock so that other hosts aren't
+  // held up.  If the handshake fails, the slot is given up so that it can
+  // be tried again.
+  if (needs_open) {
+    try {
+      conn->close_connection();
+      conn->open_connection(target);
+    }
+    catch (...) {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<std::unique_ptr<connection> >& all = hosts[target].all;
+        all.erase(std::find_if(all.begin(),all.end(),[conn] (const std::unique_ptr<connection>& c) {return c.get()==conn;}));
+      }
+      available.notify_all();
+      throw;
+    }
+  }
+
+  return pooled_connection(this,target,conn);
+
+}
+
+/**
+ * Method for returning a connection to the pool.
+ */
+
+void connection_pool::checkin(const std::string& target, connection* conn) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    hosts[target].idle.push_back(conn);
+  }
+  available.notify_all();
+}
+
+/**
+ * Sends keepalives on the idle sessions.  Sessions which are checked out
+ * are skipped because they are being used by another thread.  The idle
+ * sessions are taken out of the pool while they're pinged, so that a
+ * stalled link doesn't hold the lock and block every checkout.
+ */
+
+void connection_pool::keepalive_loop() {
+  std::unique_lock<std::mutex> lock(mtx);
+  while (running) {
+    stopping.wait_for(lock,std::chrono::seconds(keepalive_interval),[this] () {return !running;});
+    if (!running) {
+      break;
+    }
+    std::vector<std::pair<std::string,connection*> > pinged;
+    for (auto& h : hosts) {
+      for (auto conn : h.second.idle) {
+        pinged.push_back(std::make_pair(h.first,conn));
+      }
+      h.second.idle.clear();
+    }
+    lock.unlock();
+    for (auto& p : pinged) {
+      p.second->keepalive();
+    }
+    lock.lock();
+    for (auto& p : pinged) {
+      hosts[p.first].idle.push_back(p.second);
+    }
+    available.notify_all();
+  }
+}
@@ -0,0 +1,191 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <csignal>
+#include <pthread.h>
+#include "remote_tools.h"
+#include "telemetry.h"
+
+/**
+ * Returns the shell pipeline which packs the current directory, compressed
+ * at the given level (0 means no compression).
+ */
+
+static std::string pack_cmd(const int level) {
+  std::ostringstream cmd;
+  cmd << "tar -cf - .";
+  if (level>0) {
+    cmd << " | gzip -" << ((level>9) ? 9 : level);
+  }
+  return cmd.str();
+}
+
+/**
+ * Returns the shell pipeline which unpacks stdin into the current directory.
+ */
+
+static std::string unpack_cmd(const int level) {
+  return (level>0) ? "gzip -dc | tar -xf -" : "tar -xf -";
+}
+
+/**
+ * Method for copying a directory to the remote host.  The directory is
+ * packed with tar (and gzip) locally and unpacked on the remote host, and
+ * the archive is streamed over a single channel, so there's no per-file
+ * setup like there is with put_file.  Packing, sending and unpacking all
+ * run at the same time.
+ *
+ * @param[in] local_dir directory to be copied.
+ * @param[in] remote_dir directory on the remote host into which the contents are unpacked (created if needed).
+ * @param[in] level gzip compression level (1-9, 0 sends a plain tar stream).
+ */
+
+void connection::put_dir(const std::string local_dir, const std::string remote_dir, const int level) {
+
+  telemetry::scope timer(telemetry::phase_transfer,"put_dir");
+
+#ifdef VERBOSE
+  auto start = std::chrono::steady_clock::now();
+#endif
+
+  // Starting the local side
+  std::string local_cmd = "cd " + quote_path(local_dir) + " && " + pack_cmd(level);
+  FILE* pipe = popen(local_cmd.c_str(),"r");
+  if (pipe==NULL) {
+    std::ostringstream msg;
+    msg << "Can't run " << local_cmd;
+    throw cppopt_error(msg.str());
+  }
+
+  // Starting the remote side and feeding it the archive
+  std::string remote_cmd = "mkdir -p " + quote_path(remote_dir) + " && cd " + quote_path(remote_dir) + " && " + unpack_cmd(level);
+  std::vector<char> buffer(1048576);
+  uint64_t nbytes = 0;
+  exec_result result;
+  try {
+    remote_command command = exec_async(remote_cmd);
+    std::size_t n;
+    while ((n = fread(buffer.data(),1,buffer.size(),pipe))>0) {
+      command.write(buffer.data(),n);
+      nbytes += n;
+      command.poll();
+    }
+    command.send_eof();
+    result = command.wait();
+  }
+  catch (...) {
+    pclose(pipe);
+    throw;
+  }
+  int local_status = pclose(pipe);
+  if (local_status!=0 || result.exit_status!=0) {
+    std::ostringstream msg;
+    msg << "Problem copying " << local_dir << " to " << host << ":" << remote_dir << "\n" << result.err;
+    throw remote_error(msg.str());
+  }
+
+  telemetry::count(telemetry::counter_bytes_sent,nbytes);
+#ifdef VERBOSE
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+  std::cout << "Sent " << local_dir << " (" << nbytes << " bytes on the wire) in " << elapsed << " s." << std::endl;
+#endif
+
+}
+
+/**
+ * Method for copying a directory from the remote host.  The same as
+ * put_dir in the other direction.  SIGPIPE is blocked in this thread while
+ * the archive is written to the local tar, so a tar which exits early is
+ * reported as an error instead of killing the process.
+ *
+ * @param[in] remote_dir directory on the remote host to be copied.
+ * @param[in] local_dir directory into which the contents are unpacked (created if needed).
+ * @param[in] level gzip compression level (1-9, 0 sends a plain tar stream).
+ */
+
+void connection::get_dir(const std::string remote_dir, const std::string local_dir, const int level) {
+
+  telemetry::scope timer(telemetry::phase_transfer,"get_dir");
+
+#ifdef VERBOSE
+  auto start = std::chrono::steady_clock::now();
+#endif
+
+  // Starting the local side
+  std::string local_cmd = "mkdir -p " + quote_path(local_dir) + " && cd " + quote_path(local_dir) + " && " + unpack_cmd(level);
+  FILE* pipe = popen(local_cmd.c_str(),"w");
+  if (pipe==NULL) {
+    std::ostringstream msg;
+    msg << "Can't run " << local_cmd;
+    throw cppopt_error(msg.str());
+  }
+
+  // A local tar which exits early mustn't kill us with SIGPIPE
+  sigset_t pipe_set, old_set;
+  sigemptyset(&pipe_set);
+  sigaddset(&pipe_set,SIGPIPE);
+  pthread_sigmask(SIG_BLOCK,&pipe_set,&old_set);
+  auto restore_mask = [&] () {
+    // Throwing away a SIGPIPE which was raised while it was blocked
+    struct timespec zero = {0,0};
+    while (sigtimedwait(&pipe_set,NULL,&zero)>0) {}
+    pthread_sigmask(SIG_SETMASK,&old_set,NULL);
+  };
+
+  // Streaming the remote archive into it
+  uint64_t nbytes = 0;
+  bool write_failed = false;
+  exec_options opts;
+  opts.chunk_size = 1048576;
+  opts.on_stdout = [&] (const char* data, std::size_t len) {
+    if (!write_failed && fwrite(data,1,len,pipe)!=len) {
+      write_failed = true;
+    }
+    nbytes += len;
+  };
+  exec_result result;
+  try {
+    result = exec("cd " + quote_path(remote_dir) + " && " + pack_cmd(level),opts);
+  }
+  catch (...) {
+    pclose(pipe);
+    restore_mask();
+    throw;
+  }
+
+  int local_status = pclose(pipe);
+  restore_mask();
+  if (write_failed || local_status!=0 || result.exit_status!=0) {
+    std::ostringstream msg;
+    msg << "Problem copying " << host << ":" << remote_dir << " to " << local_dir << "\n" << result.err;
+    throw remote_error(msg.str());
+  }
+
+  telemetry::count(telemetry::counter_bytes_received,nbytes);
+#ifdef VERBOSE
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+  std::cout << "Received " << remote_dir << " (" << nbytes << " bytes on the wire) in " << elapsed << " s." << std::endl;
+#endif
+
+}
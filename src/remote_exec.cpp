@@ -0,0 +1,301 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <libssh/libssh.h>
+#include "remote_tools.h"
+
+/**
+ * ctor which opens a channel and starts the command.
+ *
+ * @param[in] session session on which the channel is opened.
+ * @param[in] cmd command passed to the remote shell.
+ * @param[in] opts chunk size and timeout.
+ */
+
+remote_command::remote_command(ssh_session session, const std::string cmd, const exec_options opts) : session(session), command(cmd), options(opts), input_sent(0), stdin_closed(false), finished(false) {
+
+  res.exit_status = -1;
+  res.timed_out = false;
+  if (options.chunk_size==0) {
+    options.chunk_size = 16384;
+  }
+
+  // Creating channel
+  channel = ssh_channel_new(session);
+  if (channel==NULL) {
+    throw remote_error("New channel not created.",true);
+  }
+
+  // Opening channel
+  if (ssh_channel_open_session(channel)!=SSH_OK) {
+    fail("Can't open channel");
+  }
+
+  // Passing command
+  if (ssh_channel_request_exec(channel,command.c_str())!=SSH_OK) {
+    fail("Can't execute command");
+  }
+
+  start = std::chrono::steady_clock::now();
+  feed_input();
+
+}
+
+/**
+ * move ctor
+ */
+
+remote_command::remote_command(remote_command&& other) : session(other.session), channel(other.channel), command(other.command), options(other.options), res(other.res), input_sent(other.input_sent), stdin_closed(other.stdin_closed), finished(other.finished), start(other.start) {
+  other.channel = NULL;
+  other.finished = true;
+}
+
+/**
+ * dtor which kills the command if it is still running.
+ */
+
+remote_command::~remote_command() {
+  if (!finished && channel!=NULL) {
+    cancel();
+  }
+}
+
+/**
+ * Method for collecting the output which has arrived so far, without
+ * blocking.
+ *
+ * @returns true once the command has finished.
+ */
+
+bool remote_command::poll() {
+
+  if (finished) {
+    return true;
+  }
+
+  feed_input();
+
+  // Draining stdout and stderr
+  std::vector<char> buffer(options.chunk_size);
+  int nout, nerr;
+  do {
+    nout = ssh_channel_read_nonblocking(channel,buffer.data(),buffer.size(),0);
+    if (nout>0) {
+      if (options.on_stdout) {
+        options.on_stdout(buffer.data(),nout);
+      }
+      else {
+        res.out.append(buffer.data(),nout);
+      }
+    }
+    nerr = ssh_channel_read_nonblocking(channel,buffer.data(),buffer.size(),1);
+    if (nerr>0) {
+      res.err.append(buffer.data(),nerr);
+    }
+  } while (nout>0 || nerr>0);
+
+  if (nout==SSH_ERROR || nerr==SSH_ERROR) {
+    fail("Problem reading data from channel");
+  }
+
+  // Finishing once everything has been read
+  if (ssh_channel_is_eof(channel)) {
+    finish(false);
+  }
+  else if (options.timeout_ms>=0 && std::chrono::steady_clock::now()-start>std::chrono::milliseconds(options.timeout_ms)) {
+    cancel();
+  }
+  else if (options.cancel!=NULL && options.cancel->load()) {
+    cancel();
+  }
+
+  return finished;
+
+}
+
+/**
+ * Method for writing to the command's stdin.  Blocks until the data has
+ * been sent.
+ *
+ * @param[in] data bytes to be written.
+ * @param[in] len number of bytes.
+ */
+
+void remote_command::write(const char* data, const std::size_t len) {
+  std::size_t sent = 0;
+  while (sent<len) {
+    int n = ssh_channel_write(channel,data+sent,len-sent);
+    if (n==SSH_ERROR) {
+      fail("Problem writing data to channel");
+    }
+    sent += n;
+  }
+}
+
+/**
+ * Method for closing the command's stdin.
+ */
+
+void remote_command::send_eof() {
+  if (!stdin_closed) {
+    ssh_channel_send_eof(channel);
+    stdin_closed = true;
+  }
+}
+
+bool remote_command::done() const {
+  return finished;
+}
+
+/**
+ * Method for blocking until the command has finished.
+ *
+ * @returns the output and exit status.
+ */
+
+const exec_result& remote_command::wait() {
+  while (!poll()) {
+    // Sleeping until something arrives on the session (or 10 ms)
+    ssh_channel_poll_timeout(channel,10,0);
+  }
+  return res;
+}
+
+const exec_result& remote_command::result() const {
+  return res;
+}
+
+/**
+ * Method for killing the command.  The exit status is set to -1.
+ */
+
+void remote_command::cancel() {
+  if (finished) {
+    return;
+  }
+  ssh_channel_request_send_signal(channel,"TERM");
+  finish(true);
+}
+
+/**
+ * Method for waiting on many commands at once.  Output is collected from
+ * all of them as it arrives.
+ *
+ * @param[in,out] commands commands to be waited on.
+ */
+
+void remote_command::wait_all(std::vector<remote_command>& commands) {
+  while (true) {
+    remote_command* running = NULL;
+    for (auto& c : commands) {
+      if (!c.poll() && running==NULL) {
+        running = &c;
+      }
+    }
+    if (running==NULL) {
+      break;
+    }
+    ssh_channel_poll_timeout(running->channel,10,0);
+  }
+}
+
+/**
+ * Writes as much of exec_options::input as the channel's window takes
+ * without blocking, and closes stdin once all of it has been sent.
+ */
+
+void remote_command::feed_input() {
+  if (options.input.empty() || stdin_closed) {
+    return;
+  }
+  std::size_t left = options.input.size()-input_sent;
+  std::size_t window = ssh_channel_window_size(channel);
+  std::size_t n = (left<window) ? left : window;
+  if (n>0) {
+    write(options.input.data()+input_sent,n);
+    input_sent += n;
+  }
+  if (input_sent==options.input.size()) {
+    send_eof();
+  }
+}
+
+/**
+ * Frees the channel and throws a transient remote_error.  The session is
+ * probably gone, so nothing more is sent on the channel.
+ */
+
+void remote_command::fail(const char* what) {
+  std::ostringstream msg;
+  msg << what << " (running " << command << "): " << ssh_get_error(session);
+  ssh_channel_free(channel);
+  channel = NULL;
+  finished = true;
+  throw remote_error(msg.str(),true);
+}
+
+/**
+ * Closes the channel and records the exit status.
+ */
+
+void remote_command::finish(const bool timed_out) {
+  res.timed_out = timed_out;
+  if (!timed_out) {
+    send_eof();
+  }
+  ssh_channel_close(channel);
+  if (!timed_out) {
+    res.exit_status = ssh_channel_get_exit_status(channel);
+  }
+  ssh_channel_free(channel);
+  channel = NULL;
+  finished = true;
+}
+
+/**
+ * Method for running a command on the remote host.  stdout and stderr are
+ * captured in memory.
+ *
+ * @param[in] cmd command passed to the remote shell.
+ * @param[in] opts chunk size and timeout (see exec_options).
+ * @returns stdout, stderr and the exit status.
+ */
+
+exec_result connection::exec(const std::string cmd, const exec_options opts) {
+  remote_command command = exec_async(cmd,opts);
+  return command.wait();
+}
+
+/**
+ * Method for starting a command on the remote host without waiting for it.
+ *
+ * @param[in] cmd command passed to the remote shell.
+ * @param[in] opts chunk size and timeout (see exec_options).
+ * @returns a handle which is used to poll or wait on the command.
+ */
+
+remote_command connection::exec_async(const std::string cmd, const exec_options opts) {
+  if (!connection_open) {
+    throw remote_error("Connection must be open to run commands.");
+  }
+  return remote_command(session,cmd,opts);
+}
@@ -0,0 +1,133 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include "remote_tools.h"
+
+/**
+ * Quotes a string as an awk string literal.
+ */
+
+static std::string awk_string(const std::string& s) {
+  std::string quoted("\"");
+  for (char c : s) {
+    if (c=='"' || c=='\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+/**
+ * Method for reading fields from files on the remote host.  The selection
+ * is done by awk on the remote host and only the selected fields are sent
+ * back, so reading a few numbers from a large report costs a few bytes
+ * rather than a transfer of the whole file.  All of the values are read
+ * with one command, and each file is read once no matter how many values
+ * come from it; awk stops reading a file once its values have been found.
+ *
+ * Lines are split the same way as get_value splits them (any whitespace
+ * separates fields), so the results are the same as calling get_value on
+ * a local copy of the file.
+ *
+ * @param[in] values the files, lines/labels and positions of the fields.
+ * @return The fields, in the same order as values.
+ */
+
+std::vector<std::string> connection::get_remote_fields(const std::vector<remote_value>& values) {
+
+  // Grouping the requests by file
+  std::map<std::string,std::vector<std::size_t> > by_file;
+  for (std::size_t i=0; i<values.size(); ++i) {
+    by_file[values[i].file].push_back(i);
+  }
+
+  // Building one awk program per file.  The tab, cr, vt and ff characters
+  // are turned into spaces first, since istream splits on them but awk's
+  // default field splitting doesn't.
+  std::ostringstream cmd;
+  bool first = true;
+  for (auto& kv : by_file) {
+    std::ostringstream prog;
+    prog << "BEGIN{n=" << kv.second.size() << "} {gsub(/[\\t\\r\\v\\f]/,\" \")}";
+    for (std::size_t i : kv.second) {
+      const remote_value& v = values[i];
+      if (v.label.empty()) {
+        prog << " !f" << i << " && NR==" << v.line_num+1;
+      }
+      else {
+        prog << " !f" << i << " && $1==" << awk_string(v.label);
+      }
+      prog << "{f" << i << "=1; n--; if (NF>" << v.pos << ") v" << i << "=$" << v.pos+1 << "; else m" << i << "=1}";
+    }
+    prog << " n==0{exit} END{";
+    for (std::size_t i : kv.second) {
+      prog << "print " << i << ", (f" << i << " && !m" << i << "), (f" << i << " && !m" << i << " ? v" << i << " : \"-\");";
+    }
+    prog << "}";
+    if (!first) {
+      cmd << "; ";
+    }
+    cmd << "awk " << shell_quote(prog.str()) << " " << quote_path(kv.first);
+    first = false;
+  }
+
+  exec_result result = exec(cmd.str());
+
+  // Each line of output is: index found value
+  std::vector<std::string> fields(values.size());
+  std::vector<bool> found(values.size(),false);
+  std::istringstream out(result.out);
+  std::string line;
+  while (getline(out,line)) {
+    std::istringstream ls(line);
+    std::size_t i;
+    int ok;
+    std::string value;
+    if (ls >> i >> ok >> value && i<values.size() && ok==1) {
+      fields[i] = value;
+      found[i] = true;
+    }
+  }
+
+  for (std::size_t i=0; i<values.size(); ++i) {
+    if (!found[i]) {
+      std::ostringstream msg;
+      msg << "Didn't find ";
+      if (values[i].label.empty()) {
+        msg << "field " << values[i].pos << " of line " << values[i].line_num;
+      }
+      else {
+        msg << "field " << values[i].pos << " of the line labeled " << values[i].label;
+      }
+      msg << " in remote file " << values[i].file;
+      if (!result.err.empty()) {
+        msg << "\n" << result.err;
+      }
+      throw parse_error(msg.str());
+    }
+  }
+
+  return fields;
+
+}
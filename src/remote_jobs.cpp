@@ -0,0 +1,296 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <set>
+#include <poll.h>
+#include <libssh/libssh.h>
+#include "remote_jobs.h"
+
+/**
+ * ctor
+ *
+ * @param[in] sessions_per_host number of sessions which the jobs on each host are spread over.
+ * @param[in] default_limit maximum number of jobs running at once on hosts without their own limit.
+ */
+
+remote_job_manager::remote_job_manager(const unsigned int sessions_per_host, const unsigned int default_limit) : nsessions((sessions_per_host>0) ? sessions_per_host : 1), default_limit((default_limit>0) ? default_limit : 1), next_id(0) {}
+
+/**
+ * dtor which kills any jobs which are still running.
+ */
+
+remote_job_manager::~remote_job_manager() {
+  cancel_all();
+}
+
+/**
+ * Method for setting the maximum number of jobs which run at once on a host.
+ *
+ * @param[in] target user@host of the host.
+ * @param[in] max_jobs maximum number of jobs running at once.
+ */
+
+void remote_job_manager::set_host_limit(const std::string target, const unsigned int max_jobs) {
+  host(target).limit = (max_jobs>0) ? max_jobs : 1;
+}
+
+/**
+ * Method for queueing a job.  It's started by step or run once its host
+ * has a free slot.
+ *
+ * @param[in] target user@host on which the command runs.
+ * @param[in] cmd command passed to the remote shell.
+ * @param[in] callback called with the id and output when the job finishes.
+ * @param[in] opts chunk size and timeout (see exec_options).
+ * @returns id of the job.
+ */
+
+unsigned int remote_job_manager::submit(const std::string target, const std::string cmd, job_callback callback, const exec_options opts) {
+  job j;
+  j.id = next_id++;
+  j.cmd = cmd;
+  j.callback = callback;
+  j.opts = opts;
+  host(target).queue.push_back(j);
+  return j.id;
+}
+
+/**
+ * Method for doing one pass of the event loop: queued jobs are started,
+ * running jobs are polled, and if nothing finished the thread sleeps until
+ * a session has data or the timeout runs out.
+ *
+ * Reading one channel can pull data for the other channels on the same
+ * session into libssh's buffers, where poll() on the socket doesn't see
+ * it.  So the thread only sleeps if no channel already has something
+ * buffered, and never for more than a second at a time.
+ *
+ * @param[in] timeout_ms longest time to sleep (negative sleeps until there's data).
+ * @returns true while there are jobs left.
+ */
+
+bool remote_job_manager::step(const int timeout_ms) {
+
+  for (auto& kv : hosts) {
+    start_jobs(kv.first,kv.second);
+  }
+
+  if (!collect()) {
+
+    // Sleeping on the sockets of every session with a running job, unless
+    // a channel has data or an EOF waiting already
+    bool buffered = false;
+    std::set<socket_t> fds;
+    for (auto& kv : hosts) {
+      for (auto& r : kv.second.active) {
+        fds.insert(ssh_get_fd(r.command->session));
+        ssh_channel ch = r.command->channel;
+        if (ch!=NULL && (ssh_channel_poll(ch,0)!=0 || ssh_channel_poll(ch,1)!=0 || ssh_channel_is_eof(ch))) {
+          buffered = true;
+        }
+      }
+    }
+    std::vector<struct pollfd> pfds;
+    for (auto fd : fds) {
+      struct pollfd p;
+      p.fd = fd;
+      p.events = POLLIN;
+      p.revents = 0;
+      pfds.push_back(p);
+    }
+
+    // Timeouts are checked when the jobs are polled, so don't sleep forever
+    int wait_ms = (timeout_ms<0 || timeout_ms>1000) ? 1000 : timeout_ms;
+    for (auto& kv : hosts) {
+      for (auto& r : kv.second.active) {
+        if (r.command->options.timeout_ms>=0 && wait_ms>100) {
+          wait_ms = 100;
+        }
+      }
+    }
+    if (buffered) {
+      collect();
+    }
+    else if (!pfds.empty()) {
+      ::poll(pfds.data(),pfds.size(),wait_ms);
+      collect();
+    }
+
+  }
+
+  return pending()+running()>0;
+
+}
+
+/**
+ * Method for running the event loop until every job has finished.
+ */
+
+void remote_job_manager::run() {
+  while (step(-1)) {}
+}
+
+/**
+ * Method for killing the running jobs and dropping the queued ones.
+ * Callbacks aren't called.
+ */
+
+void remote_job_manager::cancel_all() {
+  for (auto& kv : hosts) {
+    kv.second.queue.clear();
+    for (auto& r : kv.second.active) {
+      r.command->cancel();
+    }
+    kv.second.active.clear();
+  }
+}
+
+std::size_t remote_job_manager::pending() const {
+  std::size_t n = 0;
+  for (auto& kv : hosts) {
+    n += kv.second.queue.size();
+  }
+  return n;
+}
+
+std::size_t remote_job_manager::running() const {
+  std::size_t n = 0;
+  for (auto& kv : hosts) {
+    n += kv.second.active.size();
+  }
+  return n;
+}
+
+/**
+ * Finds the state of a host, adding it if it hasn't been seen.
+ */
+
+remote_job_manager::host_state& remote_job_manager::host(const std::string& target) {
+  std::map<std::string,host_state>::iterator it = hosts.find(target);
+  if (it==hosts.end()) {
+    host_state& h = hosts[target];
+    h.next_session = 0;
+    h.limit = default_limit;
+    return h;
+  }
+  return it->second;
+}
+
+/**
+ * Starts queued jobs on a host until its limit is reached.
+ */
+
+void remote_job_manager::start_jobs(const std::string& target, host_state& h) {
+
+  while (!h.queue.empty() && h.active.size()<h.limit) {
+
+    // Picking a session.  A session which was dropped is only reopened
+    // once the jobs that were running on it have been collected.
+    while (h.sessions.size()<nsessions) {
+      h.sessions.push_back(std::unique_ptr<connection>(new connection));
+    }
+    unsigned int k = h.next_session % nsessions;
+    connection& conn = *h.sessions[k];
+    if (!conn.is_open()) {
+      bool in_use = false;
+      for (auto& r : h.active) {
+        in_use = in_use || r.session==k;
+      }
+      if (in_use) {
+        break;
+      }
+    }
+    h.next_session++;
+
+    job j = h.queue.front();
+    h.queue.pop_front();
+
+    // Opening the session the first time it's needed, or again if it was
+    // dropped.  This is tried once per job, without sleeping, so that the
+    // other hosts aren't held up; a host which can't be reached fails the
+    // job instead of stopping the others.
+    try {
+      if (!conn.is_open()) {
+        conn.close_connection();
+        conn.open_connection(target);
+      }
+
+      running_job r;
+      r.id = j.id;
+      r.session = k;
+      r.callback = j.callback;
+      r.command.reset(new remote_command(conn.exec_async(j.cmd,j.opts)));
+      h.active.push_back(std::move(r));
+    }
+    catch (const remote_error& e) {
+      exec_result failed;
+      failed.exit_status = -1;
+      failed.timed_out = false;
+      failed.err = e.what();
+      if (j.callback) {
+        j.callback(j.id,failed);
+      }
+    }
+
+  }
+
+}
+
+/**
+ * Polls every running job and calls the callbacks of those which finished.
+ *
+ * @returns true if any job finished.
+ */
+
+bool remote_job_manager::collect() {
+
+  // Removing the finished jobs before calling back, so that callbacks can submit
+  std::vector<running_job> finished;
+  for (auto& kv : hosts) {
+    std::vector<running_job>& active = kv.second.active;
+    for (std::size_t i=0; i<active.size();) {
+      bool done;
+      try {
+        done = active[i].command->poll();
+      }
+      catch (const remote_error& e) {
+        // The channel is already freed, so the job is reported as failed
+        active[i].command->res.exit_status = -1;
+        active[i].command->res.err += e.what();
+        done = true;
+      }
+      if (done) {
+        finished.push_back(std::move(active[i]));
+        active[i] = std::move(active.back());
+        active.pop_back();
+      }
+      else {
+        ++i;
+      }
+    }
+  }
+
+  for (auto& r : finished) {
+    if (r.callback) {
+      r.callback(r.id,r.command->result());
+    }
+  }
+
+  return !finished.empty();
+
+}
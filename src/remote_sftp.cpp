@@ -0,0 +1,556 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libssh/libssh.h>
+#include <libssh/sftp.h>
+#include "remote_tools.h"
+#include "telemetry.h"
+
+// libssh 0.11 added sftp_aio, which pipelines both reads and writes.  Older
+// versions only have sftp_async_read, so uploads aren't pipelined there.
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0,11,0)
+#define CPPOPT_SFTP_AIO
+#endif
+
+/**
+ * State of one file in a batch transfer.
+ */
+struct sftp_xfer {
+  std::string src;
+  std::string dst;
+  int fd;
+  sftp_file file;
+  uint64_t size;
+  uint64_t issued;
+  uint64_t done;
+  unsigned int outstanding;
+};
+
+/**
+ * One outstanding read or write request.
+ */
+struct sftp_request {
+  sftp_xfer* x;
+  uint64_t offset;
+  std::size_t len;
+#ifdef CPPOPT_SFTP_AIO
+  sftp_aio aio;
+#else
+  uint32_t id;
+#endif
+};
+
+/**
+ * Method for getting the SFTP session, which is started the first time
+ * it's needed and then reused.
+ */
+
+sftp_session connection::sftp_handle() {
+
+  if (!connection_open) {
+    throw remote_error("Connection must be open to use sftp.");
+  }
+
+  if (sftp==NULL) {
+    sftp = sftp_new(session);
+    if (sftp==NULL) {
+      std::ostringstream msg;
+      msg << "Couldn't create new sftp session: " << ssh_get_error(session);
+      throw remote_error(msg.str(),true);
+    }
+    if (sftp_init(sftp)!=SSH_OK) {
+      std::ostringstream msg;
+      msg << "Couldn't initialize the sftp session (code " << sftp_get_error(sftp) << "): " << ssh_get_error(session);
+      sftp_free(sftp);
+      sftp = NULL;
+      throw remote_error(msg.str(),true);
+    }
+  }
+
+  return sftp;
+
+}
+
+/**
+ * Maps a path which uses the shell's home directory ($HOME/... or ~/...)
+ * to the SFTP equivalent.  SFTP doesn't expand variables, but relative
+ * paths are relative to the home directory.
+ */
+
+std::string connection::sftp_path(const std::string& path) {
+  const char* prefixes[] = {"$HOME", "${HOME}", "~"};
+  for (const char* prefix : prefixes) {
+    std::size_t n = strlen(prefix);
+    if (path.compare(0,n,prefix)==0 && (path.size()==n || path[n]=='/')) {
+      std::string rest = path.substr(std::min(n+1,path.size()));
+      return rest.empty() ? "." : rest;
+    }
+  }
+  return path;
+}
+
+/**
+ * Method for getting the size, mtime and type of many remote files at
+ * once.  Nothing is written locally.  Several paths are looked up with one
+ * remote command per 256 paths (a loop over stat), wherever they are, so
+ * a file in each of many run directories doesn't cost a round trip each.
+ * A single path, or a host without GNU stat, is looked up over SFTP
+ * instead: paths in the same directory with one directory listing, and a
+ * path which is alone in its directory with one SFTP stat.  Paths may
+ * start with $HOME or ~.
+ *
+ * @param[in] paths remote paths.
+ * @returns one remote_stat per path, in the same order.
+ */
+
+std::vector<remote_stat> connection::stat_files(const std::vector<std::string>& paths) {
+
+  std::vector<remote_stat> results(paths.size());
+  for (std::size_t i=0; i<paths.size(); ++i) {
+    results[i].path = paths[i];
+    results[i].exists = false;
+    results[i].is_dir = false;
+    results[i].size = 0;
+    results[i].mtime = 0;
+    results[i].mode = 0;
+  }
+
+  // Stat-ing the paths in batches, one exec each.  The loop prints one
+  // line per path, in order ("-" if it doesn't exist), after a line for
+  // "." which shows that stat understands -c.
+  bool batched = paths.size()>1;
+  for (std::size_t start=0; start<paths.size() && batched; start+=256) {
+    std::size_t stop = std::min<std::size_t>(start+256,paths.size());
+    std::ostringstream cmd;
+    cmd << "stat -L -c '%s %Y %f' . || exit 1; for p in";
+    for (std::size_t i=start; i<stop; ++i) {
+      cmd << " " << quote_path(sftp_path(paths[i]));
+    }
+    cmd << "; do stat -L -c '%s %Y %f' -- \"$p\" 2>/dev/null || echo -; done";
+    exec_result r = exec(cmd.str());
+    std::istringstream out(r.out);
+    std::string line;
+    batched = r.exit_status==0 && getline(out,line);
+    for (std::size_t i=start; i<stop && batched; ++i) {
+      batched = static_cast<bool>(getline(out,line));
+      if (!batched || line=="-") {
+        continue;
+      }
+      std::istringstream fields(line);
+      unsigned long long size;
+      long long mtime;
+      std::string mode_hex;
+      batched = static_cast<bool>(fields >> size >> mtime >> mode_hex);
+      unsigned long mode = strtoul(mode_hex.c_str(),NULL,16);
+      results[i].exists = true;
+      results[i].is_dir = S_ISDIR(mode);
+      results[i].size = size;
+      results[i].mtime = mtime;
+      results[i].mode = mode & 07777;
+    }
+  }
+  if (batched) {
+    return results;
+  }
+
+  // Grouping the paths by directory
+  sftp_session sf = sftp_handle();
+  std::map<std::string,std::vector<std::size_t> > by_dir;
+  std::vector<std::string> names(paths.size());
+  for (std::size_t i=0; i<paths.size(); ++i) {
+    std::string p = sftp_path(paths[i]);
+    while (p.size()>1 && p[p.size()-1]=='/') {
+      p.erase(p.size()-1);
+    }
+    std::size_t slash = p.rfind('/');
+    std::string dir = (slash==std::string::npos) ? "." : (slash==0 ? "/" : p.substr(0,slash));
+    names[i] = (slash==std::string::npos) ? p : p.substr(slash+1);
+    by_dir[dir].push_back(i);
+    results[i].exists = false;
+    results[i].is_dir = false;
+    results[i].size = 0;
+    results[i].mtime = 0;
+    results[i].mode = 0;
+  }
+
+  for (auto& d : by_dir) {
+
+    const std::vector<std::size_t>& idx = d.second;
+    sftp_dir dp = (idx.size()>1) ? sftp_opendir(sf,d.first.c_str()) : NULL;
+
+    if (dp==NULL) {
+
+      // Stat-ing each path
+      for (std::size_t i : idx) {
+        std::string full = (d.first=="/") ? "/" + names[i] : d.first + "/" + names[i];
+        sftp_attributes attr = sftp_stat(sf,full.c_str());
+        if (attr!=NULL) {
+          results[i].exists = true;
+          results[i].is_dir = (attr->type==SSH_FILEXFER_TYPE_DIRECTORY);
+          results[i].size = attr->size;
+          results[i].mtime = attr->mtime;
+          results[i].mode = attr->permissions & 07777;
+          sftp_attributes_free(attr);
+        }
+      }
+
+    }
+    else {
+
+      // Listing the directory once for all of the paths in it
+      std::map<std::string,std::size_t> wanted;
+      for (std::size_t i : idx) {
+        wanted.insert(std::make_pair(names[i],i));
+      }
+      sftp_attributes attr;
+      while ((attr = sftp_readdir(sf,dp))!=NULL) {
+        std::map<std::string,std::size_t>::const_iterator w = wanted.find(attr->name);
+        if (w!=wanted.end()) {
+          for (std::size_t i : idx) {
+            if (names[i]==w->first) {
+              results[i].exists = true;
+              results[i].is_dir = (attr->type==SSH_FILEXFER_TYPE_DIRECTORY);
+              results[i].size = attr->size;
+              results[i].mtime = attr->mtime;
+              results[i].mode = attr->permissions & 07777;
+            }
+          }
+        }
+        sftp_attributes_free(attr);
+      }
+      sftp_closedir(dp);
+
+    }
+
+  }
+
+  return results;
+
+}
+
+/**
+ * Method for uploading a batch of files over SFTP.  Several files are
+ * transferred at once and many write requests are kept outstanding, so
+ * the link is kept busy even when the latency is high.
+ *
+ * @param[in] files list of (local file, remote file) pairs.  Relative remote paths are relative to the remote home directory.
+ * @param[in] opts number of outstanding requests, files in flight and chunk size.
+ */
+
+void connection::put_files(const transfer_list& files, const sftp_options opts) {
+  sftp_transfer(files,true,opts);
+}
+
+/**
+ * Method for downloading a batch of files over SFTP.  Several files are
+ * transferred at once and many read requests are kept outstanding.
+ *
+ * @param[in] files list of (remote file, local file) pairs.  Relative remote paths are relative to the remote home directory.
+ * @param[in] opts number of outstanding requests, files in flight and chunk size.
+ */
+
+void connection::get_files(const transfer_list& files, const sftp_options opts) {
+  sftp_transfer(files,false,opts);
+}
+
+/**
+ * Does the work for put_files and get_files.  Requests are issued round
+ * robin over the open files until max_requests are outstanding, and then
+ * the oldest request is completed.  The server answers in order, so
+ * waiting on the oldest request never holds up the pipeline.
+ */
+
+void connection::sftp_transfer(const transfer_list& files, const bool upload, const sftp_options& opts) {
+
+  telemetry::scope timer(telemetry::phase_transfer,"sftp");
+
+  sftp_session sf = sftp_handle();
+
+  // Capping the request size at what the server accepts
+  std::size_t chunk_size = std::max<std::size_t>(opts.chunk_size,1);
+#ifdef CPPOPT_SFTP_AIO
+  sftp_limits_t limits = sftp_limits(sf);
+  if (limits!=NULL) {
+    uint64_t max_len = upload ? limits->max_write_length : limits->max_read_length;
+    if (max_len>0) {
+      chunk_size = std::min<uint64_t>(chunk_size,max_len);
+    }
+    sftp_limits_free(limits);
+  }
+#else
+  chunk_size = std::min<std::size_t>(chunk_size,32768);
+#endif
+  unsigned int max_requests = std::max(opts.max_requests,1u);
+  unsigned int max_files = std::max(opts.max_files,1u);
+
+#ifdef VERBOSE
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#endif
+  std::vector<char> buffer(chunk_size);
+  std::deque<sftp_xfer> xfers;
+  std::vector<sftp_xfer*> active;
+  std::deque<sftp_request> inflight;
+  std::size_t next_file = 0;
+  uint64_t total = 0;
+  std::size_t rr = 0;
+
+  // Collects the replies to the requests still in flight (so none are left
+  // on the session) and closes whatever is still open before giving up
+  auto fail = [&xfers,&inflight,&buffer,upload] (const std::string& what, const bool local) {
+    for (auto& req : inflight) {
+#ifdef CPPOPT_SFTP_AIO
+      if (upload) {
+        sftp_aio_wait_write(&req.aio);
+      }
+      else {
+        sftp_aio_wait_read(&req.aio,buffer.data(),req.len);
+      }
+#else
+      if (!upload) {
+        sftp_async_read(req.x->file,buffer.data(),req.len,req.id);
+      }
+#endif
+    }
+    inflight.clear();
+    for (auto& x : xfers) {
+      if (x.file!=NULL) {
+        sftp_close(x.file);
+      }
+      if (x.fd>=0) {
+        close(x.fd);
+      }
+    }
+    if (local) {
+      throw file_error(what);
+    }
+    throw remote_error(what,true);
+  };
+
+  while (true) {
+
+    // Opening files until max_files are being transferred
+    while (active.size()<max_files && next_file<files.size()) {
+      xfers.push_back(sftp_xfer());
+      sftp_xfer& x = xfers.back();
+      x.src = files[next_file].first;
+      x.dst = files[next_file].second;
+      x.issued = 0;
+      x.done = 0;
+      x.outstanding = 0;
+      x.file = NULL;
+      x.fd = -1;
+      ++next_file;
+      if (upload) {
+        struct stat ss;
+        x.fd = open(x.src.c_str(),O_RDONLY | O_CLOEXEC);
+        if (x.fd<0 || fstat(x.fd,&ss)!=0) {
+          std::ostringstream msg;
+          msg << "Can't open " << x.src << ": " << strerror(errno);
+          fail(msg.str(),true);
+        }
+        x.size = ss.st_size;
+        x.file = sftp_open(sf,x.dst.c_str(),O_WRONLY | O_CREAT | O_TRUNC,ss.st_mode & 0777);
+      }
+      else {
+        x.file = sftp_open(sf,x.src.c_str(),O_RDONLY,0);
+        sftp_attributes attr = (x.file==NULL) ? NULL : sftp_fstat(x.file);
+        if (attr==NULL) {
+          std::ostringstream msg;
+          msg << "Can't open remote file " << x.src << " (sftp code " << sftp_get_error(sf) << "): " << ssh_get_error(session);
+          fail(msg.str(),false);
+        }
+        x.size = attr->size;
+        x.fd = open(x.dst.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,(attr->permissions & 0777) ? (attr->permissions & 0777) : 0644);
+        sftp_attributes_free(attr);
+      }
+      if (x.file==NULL || x.fd<0) {
+        std::ostringstream msg;
+        msg << "Can't open " << (upload ? x.dst : x.src) << " for transfer to " << (upload ? "remote" : "local") << " " << x.dst << ": " << ssh_get_error(session);
+        fail(msg.str(),!upload && x.file!=NULL);
+      }
+      active.push_back(&x);
+    }
+
+    // Finishing files which are done
+    for (std::size_t i=0; i<active.size(); ) {
+      sftp_xfer* x = active[i];
+      if (x->done==x->size && x->outstanding==0) {
+        sftp_close(x->file);
+        close(x->fd);
+        x->file = NULL;
+        x->fd = -1;
+        total += x->size;
+        active.erase(active.begin()+i);
+      }
+      else {
+        ++i;
+      }
+    }
+    if (active.empty() && inflight.empty()) {
+      if (next_file<files.size()) {
+        continue;
+      }
+      break;
+    }
+
+    // Issuing requests round robin over the open files
+    bool issued = true;
+    while (inflight.size()<max_requests && issued) {
+      issued = false;
+      for (std::size_t k=0; k<active.size() && inflight.size()<max_requests; ++k) {
+        sftp_xfer* x = active[(rr+k) % active.size()];
+        if (x->issued>=x->size) {
+          continue;
+        }
+        sftp_request req;
+        req.x = x;
+        req.offset = x->issued;
+        req.len = std::min<uint64_t>(chunk_size,x->size-x->issued);
+        ssize_t rc;
+        if (upload) {
+          ssize_t nbytes = pread(x->fd,buffer.data(),req.len,req.offset);
+          if (nbytes!=static_cast<ssize_t>(req.len)) {
+            std::ostringstream msg;
+            msg << "Problem reading " << x->src << ".";
+            fail(msg.str(),true);
+          }
+#ifdef CPPOPT_SFTP_AIO
+          rc = sftp_aio_begin_write(x->file,buffer.data(),req.len,&req.aio);
+#else
+          // No pipelined writes before libssh 0.11
+          rc = sftp_write(x->file,buffer.data(),req.len);
+          if (rc==static_cast<ssize_t>(req.len)) {
+            x->issued += req.len;
+            x->done += req.len;
+            issued = true;
+            continue;
+          }
+#endif
+        }
+        else {
+#ifdef CPPOPT_SFTP_AIO
+          rc = sftp_aio_begin_read(x->file,req.len,&req.aio);
+#else
+          int id = sftp_async_read_begin(x->file,req.len);
+          req.id = id;
+          rc = id;
+#endif
+        }
+        if (rc<0) {
+          std::ostringstream msg;
+          msg << "Couldn't issue sftp request for " << x->src << ": " << ssh_get_error(session);
+          fail(msg.str(),false);
+        }
+        x->issued += req.len;
+        ++x->outstanding;
+        inflight.push_back(req);
+        issued = true;
+      }
+      ++rr;
+    }
+
+    if (inflight.empty()) {
+      continue;
+    }
+
+    // Completing the oldest request
+    sftp_request req = inflight.front();
+    inflight.pop_front();
+    sftp_xfer* x = req.x;
+    --x->outstanding;
+    if (upload) {
+#ifdef CPPOPT_SFTP_AIO
+      ssize_t rc = sftp_aio_wait_write(&req.aio);
+      if (rc!=static_cast<ssize_t>(req.len)) {
+        std::ostringstream msg;
+        msg << "Couldn't write data to " << x->dst << ": " << ssh_get_error(session);
+        fail(msg.str(),false);
+      }
+      x->done += req.len;
+#endif
+    }
+    else {
+#ifdef CPPOPT_SFTP_AIO
+      ssize_t rc = sftp_aio_wait_read(&req.aio,buffer.data(),req.len);
+#else
+      ssize_t rc = sftp_async_read(x->file,buffer.data(),req.len,req.id);
+#endif
+      if (rc<=0) {
+        std::ostringstream msg;
+        msg << "Problem receiving data for " << x->src << " (file shorter than " << x->size << " bytes?): " << ssh_get_error(session);
+        fail(msg.str(),false);
+      }
+      if (pwrite(x->fd,buffer.data(),rc,req.offset)!=rc) {
+        std::ostringstream msg;
+        msg << "Problem writing " << x->dst << ": " << strerror(errno);
+        fail(msg.str(),true);
+      }
+      x->done += rc;
+
+      // Asking again for the rest of a short read
+      if (static_cast<std::size_t>(rc)<req.len) {
+        sftp_request rest;
+        rest.x = x;
+        rest.offset = req.offset + rc;
+        rest.len = req.len - rc;
+        sftp_seek64(x->file,rest.offset);
+#ifdef CPPOPT_SFTP_AIO
+        ssize_t brc = sftp_aio_begin_read(x->file,rest.len,&rest.aio);
+#else
+        int brc = sftp_async_read_begin(x->file,rest.len);
+        rest.id = brc;
+#endif
+        sftp_seek64(x->file,x->issued);
+        if (brc<0) {
+          std::ostringstream msg;
+          msg << "Couldn't issue sftp request for " << x->src << ": " << ssh_get_error(session);
+          fail(msg.str(),false);
+        }
+        ++x->outstanding;
+        inflight.push_back(rest);
+      }
+    }
+
+  }
+
+  telemetry::count(upload ? telemetry::counter_bytes_sent : telemetry::counter_bytes_received,total);
+
+  // Reporting throughput
+#ifdef VERBOSE
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << (upload ? "Sent " : "Received ") << files.size() << " files (" << total << " bytes) in " << elapsed << " s";
+  if (elapsed>0.0) {
+    std::cout << " (" << total/elapsed/1.0e6 << " MB/s)";
+  }
+  std::cout << std::endl;
+#endif
+
+}
@@ -0,0 +1,404 @@
+/*
+ * This file is part of cpp-opt.
+ *
+ * cpp-opt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cpp-opt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cpp-opt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <libssh/libssh.h>
+#include <libssh/sftp.h>
+#include "remote_tools.h"
+#include "telemetry.h"
+#include "md5.h"
+
+/**
+ * A file or directory in one of the trees being synced.
+ */
+struct sync_entry {
+  bool is_dir;
+  uint64_t size;
+  int64_t mtime;
+  unsigned int mode;
+};
+
+/**
+ * Lists a local tree, keyed by path relative to base.
+ */
+
+static void list_local(const std::string& base, const std::string& rel, std::map<std::string,sync_entry>& entries) {
+  std::string dir = rel.empty() ? base : base + "/" + rel;
+  DIR* dp = opendir(dir.c_str());
+  if (dp==NULL) {
+    std::ostringstream msg;
+    msg << "Can't open directory " << dir << ": " << strerror(errno);
+    throw file_error(msg.str());
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dp))!=NULL) {
+    std::string name(entry->d_name);
+    if (name=="." || name=="..") {
+      continue;
+    }
+    std::string r = rel.empty() ? name : rel + "/" + name;
+    struct stat ss;
+    if (stat((base + "/" + r).c_str(),&ss)!=0 || !(S_ISDIR(ss.st_mode) || S_ISREG(ss.st_mode))) {
+      continue;
+    }
+    sync_entry e;
+    e.is_dir = S_ISDIR(ss.st_mode);
+    e.size = ss.st_size;
+    e.mtime = ss.st_mtime;
+    e.mode = ss.st_mode & 0777;
+    entries[r] = e;
+    if (e.is_dir) {
+      list_local(base,r,entries);
+    }
+  }
+  closedir(dp);
+}
+
+/**
+ * Lists a remote tree over SFTP, keyed by path relative to base.  Only
+ * directories which also exist locally are descended into.
+ */
+
+static void list_remote(sftp_session sf, const std::string& base, const std::string& rel, const std::map<std::string,sync_entry>& local, std::map<std::string,sync_entry>& entries) {
+  std::string dir = rel.empty() ? base : base + "/" + rel;
+  sftp_dir dp = sftp_opendir(sf,dir.c_str());
+  if (dp==NULL) {
+    return;
+  }
+  sftp_attributes attr;
+  std::vector<std::string> subdirs;
+  while ((attr = sftp_readdir(sf,dp))!=NULL) {
+    std::string name(attr->name);
+    if (name!="." && name!="..") {
+      std::string r = rel.empty() ? name : rel + "/" + name;
+      sync_entry e;
+      e.is_dir = (attr->type==SSH_FILEXFER_TYPE_DIRECTORY);
+      e.size = attr->size;
+      e.mtime = attr->mtime;
+      e.mode = attr->permissions & 0777;
+      entries[r] = e;
+      std::map<std::string,sync_entry>::const_iterator l = local.find(r);
+      if (e.is_dir && l!=local.end() && l->second.is_dir) {
+        subdirs.push_back(r);
+      }
+    }
+    sftp_attributes_free(attr);
+  }
+  sftp_closedir(dp);
+  for (auto& r : subdirs) {
+    list_remote(sf,base,r,local,entries);
+  }
+}
+
+/**
+ * Computes the md5 sum of each block of a local file.
+ */
+
+static std::vector<std::string> local_block_sums(const std::string& path, const std::size_t block_size, const bool whole_file) {
+  std::vector<std::string> sums;
+  int fd = open(path.c_str(),O_RDONLY | O_CLOEXEC);
+  if (fd<0) {
+    std::ostringstream msg;
+    msg << "Can't open " << path << ": " << strerror(errno);
+    throw file_error(msg.str());
+  }
+  std::vector<char> buffer(block_size);
+  md5 whole;
+  ssize_t nbytes;
+  while (true) {
+    std::size_t len = 0;
+    while (len<block_size && (nbytes = read(fd,buffer.data()+len,block_size-len))>0) {
+      len += nbytes;
+    }
+    if (len==0) {
+      break;
+    }
+    if (whole_file) {
+      whole.update(buffer.data(),len);
+    }
+    else {
+      md5 h;
+      h.update(buffer.data(),len);
+      sums.push_back(h.hexdigest());
+    }
+  }
+  close(fd);
+  if (whole_file) {
+    sums.push_back(whole.hexdigest());
+  }
+  return sums;
+}
+
+/**
+ * Splits command output into lines.
+ */
+
+static std::vector<std::string> split_lines(const std::string& text) {
+  std::vector<std::string> lines;
+  std::istringstream ss(text);
+  std::string line;
+  while (getline(ss,line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+/**
+ * Method for bringing a large remote file up to date block by block.  The
+ * md5 sum of every block is computed on both sides (with dd and md5sum on
+ * the remote host) and only the blocks which differ are written.  Blocks
+ * are compared at the same offsets, which catches in-place edits of large
+ * inputs such as meshes or restart files.
+ *
+ * @param[in] local_file local copy of the file.
+ * @param[in] remote_file remote copy of the file.
+ * @param[in] remote_size size of the remote file.
+ * @param[in] block_size size of the blocks.
+ * @returns number of bytes sent.
+ */
+
+uint64_t connection::sync_blocks(const std::string& local_file, const std::string& remote_file, const uint64_t remote_size, const std::size_t block_size) {
+
+  telemetry::scope timer(telemetry::phase_transfer,"sync_blocks");
+
+  // Getting the remote block sums
+  std::ostringstream cmd;
+  cmd << "f=" << quote_path(remote_file) << "; n=" << (remote_size + block_size - 1)/block_size << "; i=0; "
+      << "while [ $i -lt $n ]; do dd if=\"$f\" bs=" << block_size << " skip=$i count=1 2>/dev/null | md5sum | cut -c1-32; i=$((i+1)); done";
+  exec_result sums = exec(cmd.str());
+  std::vector<std::string> remote_sums = split_lines(sums.out);
+  std::vector<std::string> local_sums = local_block_sums(local_file,block_size,false);
+  if (sums.exit_status!=0) {
+    remote_sums.clear();
+  }
+
+  // Writing the blocks which differ
+  int fd = open(local_file.c_str(),O_RDONLY | O_CLOEXEC);
+  sftp_file file = sftp_open(sftp_handle(),sftp_path(remote_file).c_str(),O_WRONLY,0);
+  if (fd<0 || file==NULL) {
+    std::ostringstream msg;
+    msg << "Can't open " << local_file << " or remote " << remote_file << " for block sync: " << ssh_get_error(session);
+    if (fd>=0) {
+      close(fd);
+    }
+    if (file!=NULL) {
+      sftp_close(file);
+    }
+    throw remote_error(msg.str());
+  }
+  std::vector<char> buffer(block_size);
+  uint64_t sent = 0;
+  uint64_t local_size = 0;
+  for (std::size_t i=0; i<local_sums.size(); ++i) {
+    ssize_t len = pread(fd,buffer.data(),block_size,static_cast<off_t>(i)*block_size);
+    if (len<=0) {
+      break;
+    }
+    local_size += len;
+    if (i<remote_sums.size() && remote_sums[i]==local_sums[i]) {
+      continue;
+    }
+    sftp_seek64(file,static_cast<uint64_t>(i)*block_size);
+    if (sftp_write(file,buffer.data(),len)!=len) {
+      std::ostringstream msg;
+      msg << "Couldn't write block " << i << " of " << remote_file << ": " << ssh_get_error(session);
+      sftp_close(file);
+      close(fd);
+      throw remote_error(msg.str(),true);
+    }
+    sent += len;
+  }
+  telemetry::count(telemetry::counter_bytes_sent,sent);
+  sftp_close(file);
+  close(fd);
+
+  // Cutting off the end if the local file is shorter
+  if (local_size<remote_size) {
+    std::ostringstream trunc;
+    trunc << "truncate -s " << local_size << " " << quote_path(remote_file);
+    if (exec(trunc.str()).exit_status!=0) {
+      std::ostringstream msg;
+      msg << "Couldn't truncate " << remote_file << ".";
+      throw remote_error(msg.str());
+    }
+  }
+
+  return sent;
+
+}
+
+/**
+ * Method for making a remote directory tree match a local one.  Files are
+ * compared by size and mtime (and optionally by md5 sum), and only the
+ * files which differ are sent.  Small files are sent whole through
+ * put_files, and large files are updated block by block.  The mtime of
+ * every file which is sent is set to the local mtime so the next sync can
+ * skip it.
+ *
+ * @param[in] local_dir local directory.
+ * @param[in] remote_dir remote directory (relative paths are relative to the remote home directory).
+ * @param[in] opts hashing, deletion and block options (see sync_options).
+ * @returns number of bytes sent.
+ */
+
+uint64_t connection::sync_dir(const std::string local_dir, const std::string remote_dir, const sync_options opts) {
+
+  sftp_session sf = sftp_handle();
+
+  // SFTP doesn't expand ~ or $HOME, so its paths are mapped (commands use remote_dir through quote_path)
+  const std::string sftp_dir = sftp_path(remote_dir);
+
+  // Listing both trees
+  std::map<std::string,sync_entry> local, remote;
+  list_local(local_dir,"",local);
+  sftp_attributes root = sftp_stat(sf,sftp_dir.c_str());
+  if (root==NULL) {
+    if (sftp_mkdir(sf,sftp_dir.c_str(),0755)!=SSH_OK) {
+      std::ostringstream msg;
+      msg << "Can't create remote directory " << remote_dir << ": " << ssh_get_error(session);
+      throw remote_error(msg.str());
+    }
+  }
+  else {
+    sftp_attributes_free(root);
+    list_remote(sf,sftp_dir,"",local,remote);
+  }
+
+  // Deciding what to send (parents come before children in the map)
+  transfer_list whole;
+  std::vector<std::string> blocks, hash_check;
+  for (auto& kv : local) {
+    const std::string& rel = kv.first;
+    const sync_entry& l = kv.second;
+    std::string rpath = sftp_dir + "/" + rel;
+    std::map<std::string,sync_entry>::const_iterator r = remote.find(rel);
+    if (l.is_dir) {
+      if (r==remote.end() && sftp_mkdir(sf,rpath.c_str(),l.mode)!=SSH_OK) {
+        std::ostringstream msg;
+        msg << "Can't create remote directory " << rpath << ": " << ssh_get_error(session);
+        throw remote_error(msg.str());
+      }
+      continue;
+    }
+    if (r==remote.end() || r->second.is_dir) {
+      whole.push_back(std::make_pair(local_dir + "/" + rel,rpath));
+    }
+    else if (r->second.size!=l.size || r->second.mtime!=l.mtime) {
+      if (l.size>=opts.block_threshold && r->second.size>=opts.block_threshold) {
+        blocks.push_back(rel);
+      }
+      else {
+        whole.push_back(std::make_pair(local_dir + "/" + rel,rpath));
+      }
+    }
+    else if (opts.use_hash) {
+      hash_check.push_back(rel);
+    }
+  }
+
+  // Comparing md5 sums of files which look the same (in batches, one exec each)
+  for (std::size_t start=0; start<hash_check.size(); start+=256) {
+    std::size_t stop = std::min<std::size_t>(start+256,hash_check.size());
+    std::ostringstream cmd;
+    cmd << "md5sum";
+    for (std::size_t i=start; i<stop; ++i) {
+      cmd << " " << quote_path(remote_dir + "/" + hash_check[i]);
+    }
+    std::vector<std::string> lines = split_lines(exec(cmd.str()).out);
+    for (std::size_t i=start; i<stop; ++i) {
+      const std::string& rel = hash_check[i];
+      std::string remote_sum;
+      if (i-start<lines.size()) {
+        // md5sum puts a backslash in front of lines for names it had to escape
+        const std::string& line = lines[i-start];
+        remote_sum = line.substr((!line.empty() && line[0]=='\\') ? 1 : 0,32);
+      }
+      if (remote_sum!=local_block_sums(local_dir + "/" + rel,1048576,true)[0]) {
+        if (local[rel].size>=opts.block_threshold) {
+          blocks.push_back(rel);
+        }
+        else {
+          whole.push_back(std::make_pair(local_dir + "/" + rel,sftp_dir + "/" + rel));
+        }
+      }
+    }
+  }
+
+  // Sending
+  uint64_t sent = 0;
+  if (!whole.empty()) {
+    put_files(whole);
+    for (auto& f : whole) {
+      sent += local[f.first.substr(local_dir.size()+1)].size;
+    }
+  }
+  for (auto& rel : blocks) {
+    sent += sync_blocks(local_dir + "/" + rel,remote_dir + "/" + rel,remote[rel].size,opts.block_size);
+  }
+
+  // Matching the remote mtimes to the local ones
+  std::vector<std::string> changed(blocks);
+  for (auto& f : whole) {
+    changed.push_back(f.first.substr(local_dir.size()+1));
+  }
+  for (auto& rel : changed) {
+    struct timeval times[2];
+    times[0].tv_sec = local[rel].mtime;
+    times[0].tv_usec = 0;
+    times[1] = times[0];
+    sftp_utimes(sf,(sftp_dir + "/" + rel).c_str(),times);
+  }
+
+  // Removing remote files which aren't in the local tree
+  if (opts.delete_extra) {
+    std::ostringstream cmd;
+    int count = 0;
+    cmd << "rm -rf";
+    for (auto& kv : remote) {
+      std::size_t slash = kv.first.rfind('/');
+      bool parent_removed = (slash!=std::string::npos) && local.find(kv.first.substr(0,slash))==local.end();
+      if (local.find(kv.first)==local.end() && !parent_removed) {
+        cmd << " " << quote_path(remote_dir + "/" + kv.first);
+        ++count;
+      }
+    }
+    if (count>0) {
+      exec(cmd.str());
+    }
+  }
+
+#ifdef VERBOSE
+  std::cout << "Synced " << local_dir << " to " << remote_dir << ": " << whole.size() << " whole files, "
+            << blocks.size() << " block updates, " << sent << " bytes sent." << std::endl;
+#endif
+
+  return sent;
+
+}
@@ -22,8 +22,19 @@
 #include <streambuf>
 #include <string>
 #include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <libssh/libssh.h>
+#include <libssh/sftp.h>
 #include "remote_tools.h"
+#include "chunk_exchange.h"
+#include "telemetry.h"
 
 /**
  * ctor
@@ -33,7 +44,8 @@ connection::connection() {
   port = 22;
   connection_open = false;
   hash = NULL;
-  channel = NULL;
+  sftp = NULL;
+  compression_level = 0;
 }
 
 
@@ -44,6 +56,9 @@ connection::connection() {
 connection::~connection() {
   if (connection_open) {
     std::cout << "Closing connection in destructor." << std::endl;
+    if (sftp!=NULL) {
+      sftp_free(sftp);
+    }
     ssh_disconnect(session);
     ssh_free(session);
   }
@@ -53,6 +68,17 @@ connection::~connection() {
   }
 }
 
+/**
+ * Method for turning on compression of the ssh transport.  This helps on
+ * slow links with text data; on a fast network it usually costs more CPU
+ * time than it saves.  Must be called before open_connection.
+ *
+ * @param[in] level zlib compression level (1-9, 0 turns compression off).
+ */
+void connection::set_compression(const int level) {
+  compression_level = (level<0) ? 0 : ((level>9) ? 9 : level);
+}
+
 /**
  * Method for opening ssh connection
  *
@@ -63,37 +89,46 @@ void connection::open_connection(const std::string target) {
   // Opening connection
   session = ssh_new();
   if (session==NULL) {
-    std::cerr << "\nERROR: Can't open connection." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    throw remote_error("Can't open connection.");
   }
 
   // Setting options
   ssh_options_set(session,SSH_OPTIONS_HOST,target.c_str());
+  if (compression_level>0) {
+    ssh_options_set(session,SSH_OPTIONS_COMPRESSION,"yes");
+    ssh_options_set(session,SSH_OPTIONS_COMPRESSION_LEVEL,&compression_level);
+  }
   int rc = ssh_connect(session);
   if (rc != SSH_OK) {
-    std::cerr << "Error connecting to host: " << target << std::endl;
-    ssh_get_error(session);
-    exit(-1);
+    std::ostringstream msg;
+    msg << "Can't connect to host " << target << ": " << ssh_get_error(session);
+    ssh_free(session);
+    throw remote_error(msg.str(),true);
   }
 
   connection_open = true;
+  host = target;
 
   // Checking if the server is known 
   state = ssh_is_server_known(session);
+  if (hash!=NULL) {
+    // Left over from an earlier session on this connection
+    free(hash);
+    hash = NULL;
+  }
   hlen = ssh_get_pubkey_hash(session,&hash);
   if (hlen < 0) {
-    std::cerr << "ERROR: Server is not known." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    close_connection();
+    throw remote_error("Server " + target + " is not known.");
   }
 
   // Authenticating using public key
   int auth_status = ssh_userauth_publickey_auto(session,NULL,NULL);
   if (auth_status==SSH_AUTH_ERROR) {
-    std::cerr << "\nERROR: Authentication using public key failed." << std::endl;
-    ssh_get_error(session);
-    exit(-1);
+    std::ostringstream msg;
+    msg << "Authentication using public key failed: " << ssh_get_error(session);
+    close_connection();
+    throw remote_error(msg.str());
   }
   
   std::cout << "Connection to " << target << " open." << std::endl;
@@ -106,6 +141,13 @@ void connection::open_connection(const std::string target) {
  */
 void connection::close_connection() {
 
+  if (!connection_open) {
+    return;
+  }
+  if (sftp!=NULL) {
+    sftp_free(sftp);
+    sftp = NULL;
+  }
   ssh_disconnect(session);
   ssh_free(session);
   connection_open = false;
@@ -113,6 +155,35 @@ void connection::close_connection() {
 
 }
 
+/**
+ * Method for checking whether the connection is open and still connected.
+ *
+ * @returns true if the session can be used.
+ */
+bool connection::is_open() const {
+  return connection_open && ssh_is_connected(session);
+}
+
+/**
+ * Method for getting the target which was passed to open_connection.
+ */
+std::string connection::target() const {
+  return host;
+}
+
+/**
+ * Method for sending a keepalive message so that idle sessions aren't
+ * dropped by the server or by firewalls in between.
+ *
+ * @returns true if the message was sent.
+ */
+bool connection::keepalive() {
+  if (!connection_open) {
+    return false;
+  }
+  return ssh_send_ignore(session,"keepalive")==SSH_OK;
+}
+
 /**
  * Method for listing the contents of a directory.
  *
@@ -122,75 +193,19 @@ void connection::list_dir(const std::string dir) {
 
   // Making sure connection is open
   if (!connection_open) {
-    std::cerr << "\nERROR: Connection must be open to list files." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-  }
-
-  // Creating channel
-  int ch_status;
-  channel = ssh_channel_new(session);
-  if (channel==NULL) {
-    std::cerr << "\nERROR: New channel not created." << std::endl;
-    std::cerr << "From method: connection::list_dir()" << std::endl;
-    std::cerr << "Exiting." << std::endl;
-    exit(-1);
-  }
-
-  // Opening channel
-  ch_status = ssh_channel_open_session(channel);
-  if (ch_status!=SSH_OK) {
-    std::cerr << "\nERROR: Can't open channel." << std::endl;
-    std::cerr << "From method: connection::list_dir()" << std::endl;
-    std::cerr << "Exiting." << std::endl;
-    exit(-1);
-    ssh_channel_free(channel);
-  }
-
-  // Passing command 
-  std::ostringstream reqss;
-  reqss << "ls -l " << dir;
-  std::string req = reqss.str();
-  ch_status = ssh_channel_request_exec(channel,req.c_str());
-  if (ch_status!=SSH_OK) {
-    std::cerr << "\nERROR: Can't execute command: " << req << std::endl;
-    std::cerr << "From method: connection::list_dir()" << std::endl;
-    std::cerr << "Exiting." << std::endl;
-    exit(-1);
-    ssh_channel_free(channel);
-  }
-
-  // Reading data from channel
-  char buffer[512];
-  unsigned int nbytes;
-  nbytes = ssh_channel_read(channel,buffer,sizeof(buffer),0);
-  while (nbytes > 0) {
-    if (fwrite(buffer,1,nbytes,stdout)!=nbytes) {
-      ssh_channel_close(channel);
-      ssh_channel_free(channel);
-      std::cerr << "\nERROR: Problem (1) reading data from channel." << std::endl;
-      std::cerr << "Exiting.\n" << std::endl;
-      exit(-1);
-    }
-    nbytes = ssh_channel_read(channel,buffer,sizeof(buffer),0);
-  }
-  
-  if (nbytes<0) {
-    ssh_channel_close(channel);
-    ssh_channel_free(channel);
-    std::cerr << "\nERROR: Problem (2) reading data from channel." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    throw remote_error("Connection must be open to list files.");
   }
 
-  // Closing the channel
-  ssh_channel_send_eof(channel);
-  ssh_channel_close(channel);
-  ssh_channel_free(channel);
+  // Passing command
+  exec_result result = exec("ls -l " + dir);
+  std::cout << result.out;
+  std::cerr << result.err;
 
 }
 
 /**
- * Method for checking the existence of a file.
+ * Method for checking the existence of a file.  The file is looked up
+ * with an SFTP stat, so the name has to match exactly.
  *
  * @param[in] dir directory in which file will be checked.
  * @param[in] filename name of file which will be searched for.
@@ -201,267 +216,434 @@ bool connection::check_file_existence(const std::string dir, const std::string f
 
   // Making sure connection is open
   if (!connection_open) {
-    std::cerr << "\nERROR: Connection must be open to list files." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-  }
-
-  // Creating channel
-  int ch_status;
-  channel = ssh_channel_new(session);
-  if (channel==NULL) {
-    std::cerr << "\nERROR: New channel not created." << std::endl;
-    std::cerr << "From method: connection::check_file_existence()" << std::endl;
-    std::cerr << "Exiting." << std::endl;
-    exit(-1);
-  }
-
-  // Opening channel
-  ch_status = ssh_channel_open_session(channel);
-  if (ch_status!=SSH_OK) {
-    std::cerr << "\nERROR: Can't open channel." << std::endl;
-    std::cerr << "From method: connection::check_file_existence()" << std::endl;
-    std::cerr << "Exiting." << std::endl;
-    exit(-1);
-    ssh_channel_free(channel);
-  }
-
-  // Passing command 
-  std::ostringstream reqss;
-  reqss << "ls " << dir;
-  std::string req = reqss.str();
-  ch_status = ssh_channel_request_exec(channel,req.c_str());
-  if (ch_status!=SSH_OK) {
-    std::cerr << "\nERROR: Can't execute command: " << req << std::endl;
-    std::cerr << "From method: connection::check_file_existence()" << std::endl;
-    std::cerr << "Exiting." << std::endl;
-    exit(-1);
-    ssh_channel_free(channel);
+    throw remote_error("Connection must be open to list files.");
   }
 
-  // Reading data from channel
-  FILE* dir_contents;
-  dir_contents = fopen("contents","w");
-  if (dir_contents==NULL) {
-    std::cerr << "ERROR: Can't open file named contents for writing." << std::endl;
-    std::cerr << "From method: connection::check_file_existence()" << std::endl;
-    std::cerr << "Exiting." << std::endl;
-  }
-  char buffer[512];
-  unsigned int nbytes;
-  nbytes = ssh_channel_read(channel,buffer,sizeof(buffer),0);
-  while (nbytes > 0) {
-    if (fwrite(buffer,1,nbytes,dir_contents)!=nbytes) {
-      ssh_channel_close(channel);
-      ssh_channel_free(channel);
-      std::cerr << "\nERROR: Problem (1) reading data from channel." << std::endl;
-      std::cerr << "From method: connection::check_file_existence()" << std::endl;
-      std::cerr << "Exiting.\n" << std::endl;
-      exit(-1);
-    }
-    nbytes = ssh_channel_read(channel,buffer,sizeof(buffer),0);
-  }
-  fclose(dir_contents);
-  
-  if (nbytes<0) {
-    ssh_channel_close(channel);
-    ssh_channel_free(channel);
-    std::cerr << "\nERROR: Problem (2) reading data from channel." << std::endl;
-    std::cerr << "From method: connection::check_file_existence()" << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
-  }
-
-  // Closing the channel
-  ssh_channel_send_eof(channel);
-  ssh_channel_close(channel);
-  ssh_channel_free(channel);
-
-  // Reading file
-  std::ifstream dircontents("contents");
-  if (!dircontents.is_open()) {
-    std::cerr << "\nERROR: Can't open file named contents for reading." << std::endl;
-    std::cerr << "From method: connection::check_file_existence()" << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
-  }
-  std::string line;
-  std::ostringstream output;
-  std::size_t found;
-  output << std::fixed;
-  bool located = false;
-  while (getline(dircontents,line)) {
-    found = line.find(filename);
-    if (found!=std::string::npos) {
-      located = true;
-      break;
-    }
-  }
-
-  return located;
+  return stat_files(std::vector<std::string>(1,dir + "/" + filename))[0].exists;
 
 }
 
 /**
- * Method for scp-ing a file from local machine to remote host.
+ * Method for scp-ing a file from local machine to remote host.  The file
+ * is streamed in fixed size chunks.  A reader thread reads the next chunk
+ * from disk while the current one is being sent, so memory use doesn't
+ * depend on the file size.  The permissions of the local file are kept.
  * 
  * @param[in] src_file name of file to be transferred.
  * @param[in] target_dir directory to which the file will be transferred.
+ * @param[in] chunk_size size of the chunks in bytes (default is 1 MiB).
  */
 
-void connection::put_file(const std::string src_file, const std::string target_dir) {
+void connection::put_file(const std::string src_file, const std::string target_dir, const std::size_t chunk_size) {
+
+  telemetry::scope timer(telemetry::phase_transfer,"put_file");
 
   // Making sure ssh session is open
   if (!connection_open) {
-    std::cerr << "\nERROR: Connection must be open to scp files." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
+    throw remote_error("Connection must be open to scp files.");
+  }
+
+  // Getting the size and permissions of the file
+  int fd = open(src_file.c_str(),O_RDONLY | O_CLOEXEC);
+  struct stat ss;
+  if (fd<0 || fstat(fd,&ss)!=0) {
+    std::ostringstream msg;
+    msg << "Can't open " << src_file << ": " << strerror(errno);
+    if (fd>=0) {
+      close(fd);
+    }
+    throw file_error(msg.str());
   }
+  uint64_t length = static_cast<uint64_t>(ss.st_size);
+  posix_fadvise(fd,0,0,POSIX_FADV_SEQUENTIAL);
 
   // Creating new scp 
-  scp = ssh_scp_new(session,SSH_SCP_WRITE,target_dir.c_str());
+  ssh_scp scp = ssh_scp_new(session,SSH_SCP_WRITE,target_dir.c_str());
   if (scp==NULL) {
-    std::cerr << "\nERROR: Couldn't create new scp session." << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    std::ostringstream msg;
+    msg << "Couldn't create new scp session: " << ssh_get_error(session);
+    close(fd);
+    throw remote_error(msg.str(),true);
   }
 
   // Initializing scp connection
   int rc = ssh_scp_init(scp);
   if (rc!=SSH_OK) {
-    std::cerr << "\nERROR: Couldn't initialize the scp connection." << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
+    std::ostringstream msg;
+    msg << "Couldn't initialize the scp connection: " << ssh_get_error(session);
     ssh_scp_free(scp);
-    exit(-1);
+    close(fd);
+    throw remote_error(msg.str(),true);
   }
-  
-  // Reading the file into an std::string
-  std::ifstream srcstream(src_file.c_str());
-  std::string file_contents;
-  srcstream.seekg(0,std::ios::end);
-  file_contents.reserve(srcstream.tellg());
-  srcstream.seekg(0,std::ios::beg);
-  file_contents.assign((std::istreambuf_iterator<char>(srcstream)),std::istreambuf_iterator<char>());
-  int length = strlen(file_contents.c_str());
-
-  // Creating the file
-  rc = ssh_scp_push_file(scp,src_file.c_str(),length,0600);
+
+  // Creating the file (scp only takes the name, not the local path)
+  std::size_t slash = src_file.rfind('/');
+  std::string name = (slash==std::string::npos) ? src_file : src_file.substr(slash+1);
+  rc = ssh_scp_push_file64(scp,name.c_str(),length,ss.st_mode & 0777);
   if (rc!=SSH_OK) {
-    std::cerr << "\nERROR: Couldn't push the file." << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    std::ostringstream msg;
+    msg << "Couldn't push the file: " << ssh_get_error(session);
+    ssh_scp_free(scp);
+    close(fd);
+    throw remote_error(msg.str(),true);
+  }
+
+  // Reading chunks from disk in another thread
+#ifdef VERBOSE
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#endif
+  chunk_exchange chunks(2,chunk_size);
+  std::thread reader([fd,length,&chunks] () {
+    uint64_t remaining = length;
+    while (true) {
+      chunk* c = chunks.get_empty();
+      c->len = 0;
+      c->error = false;
+      while (c->len<c->data.size() && remaining>0) {
+        ssize_t nbytes = read(fd,c->data.data()+c->len,c->data.size()-c->len);
+        if (nbytes<0 && errno==EINTR) {
+          continue;
+        }
+        if (nbytes<=0) {
+          c->error = true;
+          break;
+        }
+        c->len += nbytes;
+        remaining -= nbytes;
+      }
+      bool last = (c->len==0 || c->error);
+      chunks.put_full(c);
+      if (last) {
+        break;
+      }
+    }
+  });
+
+  // Writing the data to the file (after a failed write, the rest is
+  // drained so that the reader thread finishes)
+  uint64_t sent = 0;
+  bool read_error = false;
+  std::string write_error;
+  while (true) {
+    chunk* c = chunks.get_full();
+    if (c->error) {
+      read_error = true;
+    }
+    if (c->len==0 || c->error) {
+      chunks.put_empty(c);
+      break;
+    }
+    if (write_error.empty()) {
+      rc = ssh_scp_write(scp,c->data.data(),c->len);
+      if (rc!=SSH_OK) {
+        write_error = ssh_get_error(session);
+      }
+      else {
+        sent += c->len;
+      }
+    }
+    chunks.put_empty(c);
   }
+  reader.join();
+  close(fd);
 
-  // Writing the data to the file
-  rc = ssh_scp_write(scp,file_contents.c_str(),length);
-  if (rc!=SSH_OK) {
-    std::cerr << "\nERROR: Couldn't write data to the file." << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+  if (!write_error.empty()) {
+    ssh_scp_free(scp);
+    throw remote_error("Couldn't write data to the file: " + write_error,true);
+  }
+  if (read_error || sent!=length) {
+    ssh_scp_free(scp);
+    std::ostringstream msg;
+    msg << "Problem reading " << src_file << " (sent " << sent << " of " << length << " bytes).";
+    throw file_error(msg.str());
   }
 
   // Cleaning up
   ssh_scp_close(scp);
   ssh_scp_free(scp);
 
+  telemetry::count(telemetry::counter_bytes_sent,length);
+
+  // Reporting throughput
+#ifdef VERBOSE
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Sent " << src_file << " (" << length << " bytes) in " << elapsed << " s";
+  if (elapsed>0.0) {
+    std::cout << " (" << length/elapsed/1.0e6 << " MB/s)";
+  }
+  std::cout << std::endl;
+#endif
+
+}
+
+/**
+ * Quotes a path for the remote (or local) shell.  See shell_quote: only a
+ * leading ~ or $HOME is expanded.
+ */
+
+std::string connection::quote_path(const std::string& path) {
+  return shell_quote(path);
+}
+
+/**
+ * Writes the chunks handed over by a chunk_exchange to a file descriptor
+ * until the end marker (a chunk with len==0) arrives.  Run in its own
+ * thread so that writing to disk overlaps reading from the network.
+ */
+
+static void write_chunks(const int fd, chunk_exchange& chunks, bool& error) {
+  while (true) {
+    chunk* c = chunks.get_full();
+    if (c->len==0) {
+      chunks.put_empty(c);
+      break;
+    }
+    for (std::size_t written=0; written<c->len && !error; ) {
+      ssize_t nbytes = write(fd,c->data.data()+written,c->len-written);
+      if (nbytes<0 && errno==EINTR) {
+        continue;
+      }
+      if (nbytes<0) {
+        error = true;
+        break;
+      }
+      written += nbytes;
+    }
+    chunks.put_empty(c);
+  }
 }
 
 /**
- * Method for getting a file from the remote host.
+ * Method for getting a file from the remote host.  The file is received
+ * in fixed size chunks into two buffers, and a writer thread writes one
+ * to disk while the next is arriving.  The number of bytes received is
+ * checked against the size reported by the remote host.
+ *
+ * If resume is true and part of the file is already there locally, only
+ * the rest of the file is transferred (through tail on the remote host,
+ * because scp always starts from the beginning).
  *
  * @param[in] target_file name of file to be scp-ed.
  * @param[in] target_dir name of directory which contains target_file.
  * @param[in] local_file name or full path at which file will be stored.
+ * @param[in] resume whether a partial local_file is continued (default is false).
+ * @param[in] chunk_size size of the chunks in bytes (default is 1 MiB).
  */
 
-void connection::get_file(const std::string target_file, const std::string target_dir, const std::string local_file) {
+void connection::get_file(const std::string target_file, const std::string target_dir, const std::string local_file, const bool resume, const std::size_t chunk_size) {
+
+  telemetry::scope timer(telemetry::phase_transfer,"get_file");
 
   // Making sure ssh session is open
   if (!connection_open) {
-    std::cerr << "\nERROR: Connection must be open to scp files." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
+    throw remote_error("Connection must be open to scp files.");
   }
 
   // Forming file name
   std::string trgt(target_dir+"/"+target_file);
 
+  // Continuing a partial download
+  struct stat ls;
+  if (resume && stat(local_file.c_str(),&ls)==0 && ls.st_size>0) {
+    resume_file(trgt,local_file,static_cast<uint64_t>(ls.st_size),chunk_size);
+    return;
+  }
+
   // Creating new scp 
-  scp = ssh_scp_new(session,SSH_SCP_READ,trgt.c_str());
+  ssh_scp scp = ssh_scp_new(session,SSH_SCP_READ,trgt.c_str());
   if (scp==NULL) {
-    std::cerr << "\nERROR: Couldn't create new scp session." << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    std::ostringstream msg;
+    msg << "Couldn't create new scp session: " << ssh_get_error(session);
+    throw remote_error(msg.str(),true);
   }
 
   // Initializing scp connection
   int rc = ssh_scp_init(scp);
   if (rc!=SSH_OK) {
-    std::cerr << "\nERROR: Couldn't initialize the scp connection." << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
+    std::ostringstream msg;
+    msg << "Couldn't initialize the scp connection: " << ssh_get_error(session);
     ssh_scp_free(scp);
-    exit(-1);
+    throw remote_error(msg.str(),true);
   }
  
-  // Creating pull request
-  int size,mode;
-  char *filename, *buffer;
+  // Creating pull request (fails if the remote file doesn't exist)
   rc = ssh_scp_pull_request(scp);
   if (rc!=SSH_SCP_REQUEST_NEWFILE) {
-    std::cerr << "\nERROR: Can't receive information about file." << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+    std::ostringstream msg;
+    msg << "Can't receive information about " << trgt << ": " << ssh_get_error(session);
+    ssh_scp_free(scp);
+    throw remote_error(msg.str());
   }
 
-  // Getting size and filename, etc
-  size = ssh_scp_request_get_size(scp);
-  filename = strdup(ssh_scp_request_get_filename(scp));
-  mode = ssh_scp_request_get_permissions(scp);
-  std::cout << "Reading " << filename << " size: " << size << std::endl;
+  // Getting size and permissions
+  uint64_t size = ssh_scp_request_get_size64(scp);
+  int mode = ssh_scp_request_get_permissions(scp);
+  std::cout << "Reading " << ssh_scp_request_get_filename(scp) << " size: " << size << std::endl;
 
-  // Allocating memory for the buffer
-  buffer = (char *)malloc(size);
-  if (buffer==NULL) {
-    std::cerr << "\nERROR: Can't allocate memory for buffer." << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+  // Opening the local file
+  int fd = open(local_file.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,(mode>0) ? (mode & 0777) : 0644);
+  if (fd<0) {
+    std::ostringstream msg;
+    msg << "Can't open " << local_file << " to write: " << strerror(errno);
+    ssh_scp_free(scp);
+    throw file_error(msg.str());
   }
 
-  // Reading file
+  // Reading file while the writer thread writes the previous chunk
   ssh_scp_accept_request(scp);
-  rc = ssh_scp_read(scp,buffer,size);
-  if (rc==SSH_ERROR) {
-    std::cerr << "\nERROR: Problem receiving file data:" << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << trgt << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    free(buffer);
-    exit(-1);
-  }
-
-  // Writing 
-  FILE* fp;
-  fp = fopen(local_file.c_str(),"w");
-  fwrite(buffer,1,size,fp);
-  fclose(fp);
+  chunk_exchange chunks(2,chunk_size);
+  bool write_error = false;
+  std::thread writer(write_chunks,fd,std::ref(chunks),std::ref(write_error));
+  uint64_t received = 0;
+  std::string read_error;
+  while (received<size && read_error.empty()) {
+    chunk* c = chunks.get_empty();
+    c->len = 0;
+    while (c->len<c->data.size() && received<size) {
+      std::size_t want = std::min<uint64_t>(c->data.size()-c->len,size-received);
+      rc = ssh_scp_read(scp,c->data.data()+c->len,want);
+      if (rc==SSH_ERROR || rc==0) {
+        read_error = ssh_get_error(session);
+        break;
+      }
+      c->len += rc;
+      received += rc;
+    }
+    chunks.put_full(c);
+  }
+  chunk* end = chunks.get_empty();
+  end->len = 0;
+  chunks.put_full(end);
+  writer.join();
+  close(fd);
+
+  // Checking that everything arrived
+  if (!read_error.empty()) {
+    ssh_scp_free(scp);
+    throw remote_error("Problem receiving " + trgt + ": " + read_error,true);
+  }
+  if (write_error || received!=size) {
+    ssh_scp_free(scp);
+    std::ostringstream msg;
+    msg << "Problem writing " << local_file << " (received " << received << " of " << size << " bytes).";
+    throw file_error(msg.str());
+  }
+  telemetry::count(telemetry::counter_bytes_received,received);
 
   // Pulling
   rc = ssh_scp_pull_request(scp);
-  if (rc!=SSH_ERROR) {
-    std::cerr << "\nERROR: Unexpected request:" << std::endl;
-    std::cerr << ssh_get_error(session) << std::endl;
-    std::cerr << "Exiting.\n" << std::endl;
-    exit(-1);
+  if (rc!=SSH_SCP_REQUEST_EOF) {
+    std::ostringstream msg;
+    msg << "Unexpected request: " << ssh_get_error(session);
+    ssh_scp_free(scp);
+    throw remote_error(msg.str(),true);
   }
 
   // Cleaning up
-  free(filename);
-  free(buffer);
   ssh_scp_close(scp);
   ssh_scp_free(scp);
 
 }
+
+/**
+ * Method for getting the rest of a partially downloaded file.  The remote
+ * size is printed first and then the bytes after offset are streamed over
+ * an exec channel.
+ *
+ * @param[in] trgt full path of the file on the remote host.
+ * @param[in] local_file partially downloaded file.
+ * @param[in] offset number of bytes already in local_file.
+ * @param[in] chunk_size size of the chunks in bytes.
+ */
+
+void connection::resume_file(const std::string trgt, const std::string local_file, const uint64_t offset, const std::size_t chunk_size) {
+
+  // Creating channel
+  ssh_channel channel = ssh_channel_new(session);
+  if (channel==NULL || ssh_channel_open_session(channel)!=SSH_OK) {
+    if (channel!=NULL) {
+      ssh_channel_free(channel);
+    }
+    throw remote_error("Can't open channel: " + std::string(ssh_get_error(session)),true);
+  }
+
+  // Passing command
+  std::ostringstream reqss;
+  reqss << "wc -c < " << quote_path(trgt) << " && tail -c +" << offset+1 << " " << quote_path(trgt);
+  std::string req = reqss.str();
+  if (ssh_channel_request_exec(channel,req.c_str())!=SSH_OK) {
+    std::ostringstream msg;
+    msg << "Can't execute command: " << req;
+    ssh_channel_free(channel);
+    throw remote_error(msg.str(),true);
+  }
+
+  // Reading the size of the remote file (first line of the output)
+  std::string size_line;
+  char c;
+  while (ssh_channel_read(channel,&c,1,0)==1 && c!='\n') {
+    size_line += c;
+  }
+  uint64_t size = strtoull(size_line.c_str(),NULL,10);
+  if (size_line.empty() || size<offset) {
+    std::ostringstream msg;
+    msg << "Can't resume " << local_file << " (remote size: " << size_line << ", local size: " << offset << ").";
+    ssh_channel_close(channel);
+    ssh_channel_free(channel);
+    throw remote_error(msg.str());
+  }
+#ifdef VERBOSE
+  std::cout << "Resuming " << trgt << " at " << offset << " of " << size << " bytes" << std::endl;
+#endif
+
+  // Appending the rest of the file
+  int fd = open(local_file.c_str(),O_WRONLY | O_APPEND | O_CLOEXEC);
+  if (fd<0) {
+    std::ostringstream msg;
+    msg << "Can't open " << local_file << " to write: " << strerror(errno);
+    ssh_channel_close(channel);
+    ssh_channel_free(channel);
+    throw file_error(msg.str());
+  }
+  chunk_exchange chunks(2,chunk_size);
+  bool write_error = false;
+  std::thread writer(write_chunks,fd,std::ref(chunks),std::ref(write_error));
+  uint64_t received = offset;
+  int nbytes = 1;
+  while (nbytes>0) {
+    chunk* ch = chunks.get_empty();
+    ch->len = 0;
+    while (ch->len<ch->data.size()) {
+      nbytes = ssh_channel_read(channel,ch->data.data()+ch->len,ch->data.size()-ch->len,0);
+      if (nbytes<=0) {
+        break;
+      }
+      ch->len += nbytes;
+    }
+    received += ch->len;
+    if (ch->len>0) {
+      chunks.put_full(ch);
+    }
+    else {
+      chunks.put_empty(ch);
+    }
+  }
+  chunk* end = chunks.get_empty();
+  end->len = 0;
+  chunks.put_full(end);
+  writer.join();
+  close(fd);
+
+  // Closing the channel
+  ssh_channel_send_eof(channel);
+  ssh_channel_close(channel);
+  ssh_channel_free(channel);
+
+  // Checking that everything arrived
+  if (nbytes<0 || write_error || received!=size) {
+    std::ostringstream msg;
+    msg << "Problem resuming " << local_file << " (have " << received << " of " << size << " bytes).";
+    throw remote_error(msg.str(),!write_error);
+  }
+
+}
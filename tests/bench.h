@@ -0,0 +1,88 @@
+#ifndef BENCHHEADERDEF
+#define BENCHHEADERDEF
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+/**
+ * Helpers shared by the benchmarks.  Each result is written as one JSON
+ * object per line (JSON Lines) so runs can be compared by a script.  The
+ * results are appended to the file named by the first argument, or go to
+ * stdout.  Whatever the library prints to std::cout is dropped either way,
+ * since printing would be timed too.  If BENCH_TAG is set (e.g., to a
+ * commit hash), it's added to every record.
+ */
+
+inline std::ostream& bench_output(int argc, char** argv) {
+  static std::ofstream file;
+  static std::ostream out(std::cout.rdbuf());
+  std::cout.rdbuf(NULL);
+  if (argc>1) {
+    file.open(argv[1],std::ios::app);
+    return file;
+  }
+  return out;
+}
+
+class bench_record {
+
+  public:
+
+    bench_record(std::ostream& out, const std::string bench) : out(out) {
+      line << "{\"bench\":\"" << bench << "\"";
+      const char* tag = getenv("BENCH_TAG");
+      if (tag!=NULL) {
+        add("tag",std::string(tag));
+      }
+    }
+
+    ~bench_record() {
+      out << line.str() << "}\n";
+      out.flush();
+    }
+
+    bench_record& add(const std::string key, const std::string value) {
+      line << ",\"" << key << "\":\"" << value << "\"";
+      return *this;
+    }
+
+    bench_record& add(const std::string key, const char* value) {
+      return add(key,std::string(value));
+    }
+
+    bench_record& add(const std::string key, const double value) {
+      char buf[32];
+      snprintf(buf,sizeof(buf),"%.9g",value);
+      // JSON has no inf or nan
+      line << ",\"" << key << "\":" << ((value-value==0.0) ? buf : "null");
+      return *this;
+    }
+
+    bench_record& add(const std::string key, const long long value) {
+      line << ",\"" << key << "\":" << value;
+      return *this;
+    }
+
+    bench_record& flag(const std::string key, const bool value) {
+      line << ",\"" << key << "\":" << (value ? "true" : "false");
+      return *this;
+    }
+
+  private:
+
+    std::ostream& out;
+    std::ostringstream line;
+
+};
+
+// Seconds since start
+inline double seconds_since(const std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+#endif
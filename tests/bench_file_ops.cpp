@@ -0,0 +1,102 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "file_ops.h"
+#include "bench.h"
+
+using namespace std;
+
+// Size of the file which is copied, in MiB (CPPOPT_BENCH_MB, default 256)
+size_t bench_mb() {
+  const char* mb = getenv("CPPOPT_BENCH_MB");
+  return (mb!=NULL && atoi(mb)>0) ? static_cast<size_t>(atoi(mb)) : 256;
+}
+
+size_t file_size(const string name) {
+  struct stat ss;
+  return (stat(name.c_str(),&ss)==0) ? static_cast<size_t>(ss.st_size) : 0;
+}
+
+void report(ostream& out, const string op, const size_t bytes, const double seconds) {
+  bench_record(out,"file_ops").add("op",op).add("bytes",static_cast<long long>(bytes))
+    .add("wall_s",seconds).add("mb_per_s",bytes/1048576.0/seconds);
+}
+
+int main(int argc, char** argv) {
+
+  ostream& out = bench_output(argc,argv);
+  const size_t nlines = 1000000;
+
+  // An input deck with a million lines and the variable near the end
+  {
+    ofstream deck("bench_deck.inp");
+    for (size_t i=0; i<nlines; ++i) {
+      deck << "  param_" << i << " = " << i << "  ! comment\n";
+      if (i==nlines-10) {
+        deck << "  mach = MACH\n";
+      }
+    }
+  }
+  size_t bytes = file_size("bench_deck.inp");
+  auto start = chrono::steady_clock::now();
+  replace_var("bench_deck.inp","MACH",0.85);
+  report(out,"replace_var",bytes,seconds_since(start));
+
+  // Grabbing one value from the last line
+  start = chrono::steady_clock::now();
+  double v = get_value<double>("bench_deck.inp",nlines,2);
+  report(out,"get_value",bytes,seconds_since(start));
+  if (v!=nlines-1) {
+    cerr << "get_value read " << v << endl;
+  }
+
+  // A million numbers, as text and as binary
+  {
+    ofstream txt("bench_vector.dat");
+    txt << "# sensitivities\n";
+    txt.precision(17);
+    vector<double> data(nlines);
+    for (size_t i=0; i<nlines; ++i) {
+      data[i] = 1.0/(i+1);
+      txt << data[i] << "\n";
+    }
+    FILE* fp = fopen("bench_vector.bin","wb");
+    fwrite(data.data(),sizeof(double),data.size(),fp);
+    fclose(fp);
+  }
+  start = chrono::steady_clock::now();
+  vector<double> vec = read_vector<double>("bench_vector.dat",1);
+  report(out,"read_vector",file_size("bench_vector.dat"),seconds_since(start));
+  start = chrono::steady_clock::now();
+  vec = read_binary_vector<double>("bench_vector.bin");
+  report(out,"read_binary_vector",file_size("bench_vector.bin"),seconds_since(start));
+
+  // Copying a large file
+  {
+    vector<char> block(1048576);
+    for (size_t i=0; i<block.size(); ++i) {
+      block[i] = static_cast<char>(i*2654435761u >> 24);
+    }
+    FILE* fp = fopen("bench_big.bin","wb");
+    for (size_t i=0; i<bench_mb(); ++i) {
+      fwrite(block.data(),1,block.size(),fp);
+    }
+    fclose(fp);
+  }
+  start = chrono::steady_clock::now();
+  copy_file("bench_big.bin","bench_big_copy.bin");
+  report(out,"copy_file",file_size("bench_big.bin"),seconds_since(start));
+
+  remove("bench_deck.inp");
+  remove("bench_vector.dat");
+  remove("bench_vector.bin");
+  remove("bench_big.bin");
+  remove("bench_big_copy.bin");
+
+  return 0;
+
+}
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "steepest_descent.h"
+#include "newton.h"
+#include "gss.h"
+#include "secant.h"
+#include "bench.h"
+
+using namespace std;
+
+// Test functions, each with its gradient and known minimum
+
+double rosenbrock(const vector<double>& X) {
+  double F = 0.0;
+  for (size_t i=0; i+1<X.size(); ++i) {
+    F += 100.0*pow(X[i+1]-X[i]*X[i],2) + pow(1.0-X[i],2);
+  }
+  return F;
+}
+
+vector<double> rosenbrock_grad(const vector<double>& X) {
+  vector<double> g(X.size(),0.0);
+  for (size_t i=0; i+1<X.size(); ++i) {
+    g[i] += -400.0*X[i]*(X[i+1]-X[i]*X[i]) - 2.0*(1.0-X[i]);
+    g[i+1] += 200.0*(X[i+1]-X[i]*X[i]);
+  }
+  return g;
+}
+
+double booth(const vector<double>& X) {
+  return pow(X[0]+2.0*X[1]-7.0,2) + pow(2.0*X[0]+X[1]-5.0,2);
+}
+
+vector<double> booth_grad(const vector<double>& X) {
+  double a = X[0]+2.0*X[1]-7.0;
+  double b = 2.0*X[0]+X[1]-5.0;
+  return vector<double>({2.0*a+4.0*b, 4.0*a+2.0*b});
+}
+
+// Ill-conditioned quadratic: sum of i*(x_i-1)^2
+double ellipsoid(const vector<double>& X) {
+  double F = 0.0;
+  for (size_t i=0; i<X.size(); ++i) {
+    F += (i+1)*pow(X[i]-1.0,2);
+  }
+  return F;
+}
+
+vector<double> ellipsoid_grad(const vector<double>& X) {
+  vector<double> g(X.size());
+  for (size_t i=0; i<X.size(); ++i) {
+    g[i] = 2.0*(i+1)*(X[i]-1.0);
+  }
+  return g;
+}
+
+double quartic(const double x) {
+  return pow(x,4) - 3.0*pow(x,3) + 2.0;
+}
+
+double quartic_slope(double x) {
+  return 4.0*pow(x,3) - 9.0*pow(x,2);
+}
+
+struct problem {
+  string name;
+  double (*f)(const vector<double>&);
+  vector<double> (*g)(const vector<double>&);
+  vector<double> x0;
+  vector<double> x_opt;
+};
+
+// Runs fn until at least min_time has passed and returns the time per run
+template <typename Fn>
+double time_per_run(Fn fn, const double min_time=0.05) {
+  int runs = 0;
+  auto start = chrono::steady_clock::now();
+  do {
+    fn();
+    ++runs;
+  } while (seconds_since(start)<min_time);
+  return seconds_since(start)/runs;
+}
+
+// Evaluations are counted by calling the test function through tracked,
+// which also notes when f first gets within target of the minimum
+const double target = 1.0e-6;
+double (*tracked_f)(const vector<double>&);
+double tracked_f_min;
+long long tracked_evals;
+long long evals_to_target;
+
+double tracked(const vector<double>& X) {
+  double F = tracked_f(X);
+  ++tracked_evals;
+  if (evals_to_target<0 && F-tracked_f_min<target) {
+    evals_to_target = tracked_evals;
+  }
+  return F;
+}
+
+// The same for the one-dimensional methods
+double (*tracked_f1)(const double);
+
+double tracked1(const double x) {
+  ++tracked_evals;
+  return tracked_f1(x);
+}
+
+void track(double (*f)(const vector<double>&), const double f_min) {
+  tracked_f = f;
+  tracked_f_min = f_min;
+  tracked_evals = 0;
+  evals_to_target = -1;
+}
+
+void report(ostream& out, const string& optimizer, const problem& p, const vector<double>& x, const double wall) {
+  double err = 0.0;
+  for (size_t i=0; i<x.size(); ++i) {
+    err = max(err,fabs(x[i]-p.x_opt[i]));
+  }
+  double f = p.f(x);
+  bench_record r(out,"optimizer");
+  r.add("optimizer",optimizer).add("function",p.name).add("n",static_cast<long long>(x.size()))
+   .add("evals",tracked_evals).add("wall_s",wall).add("f",f).add("x_error",err).flag("converged",f<target);
+  if (evals_to_target>=0) {
+    r.add("evals_to_tol",evals_to_target);
+  }
+  else {
+    r.add("evals_to_tol",nan(""));
+  }
+}
+
+int main(int argc, char** argv) {
+
+  ostream& out = bench_output(argc,argv);
+  const double tol = 1.0e-8;
+  const unsigned int max_iter = 2000;
+
+  vector<problem> problems;
+  problems.push_back({"booth",&booth,&booth_grad,{5.0,2.2},{1.0,3.0}});
+  problems.push_back({"rosenbrock",&rosenbrock,&rosenbrock_grad,{-1.2,1.0},{1.0,1.0}});
+  for (size_t n : {4, 8}) {
+    vector<double> x0(n);
+    for (size_t i=0; i<n; ++i) {
+      x0[i] = (i % 2==0) ? -1.2 : 1.0;
+    }
+    problems.push_back({"rosenbrock",&rosenbrock,&rosenbrock_grad,x0,vector<double>(n,1.0)});
+  }
+  for (size_t n : {10, 20}) {
+    problems.push_back({"ellipsoid",&ellipsoid,&ellipsoid_grad,vector<double>(n,3.0),vector<double>(n,1.0)});
+  }
+
+  for (auto& p : problems) {
+
+    // Counting with tracked, then timing with the bare function
+    vector<double> x;
+    double (*f)(const vector<double>&) = p.f;
+    auto sd = [&] () {x = steepest_descent(p.x0,tol,max_iter,f);};
+    auto sdg = [&] () {x = steepest_descent(p.x0,tol,max_iter,f,p.g);};
+    auto nt = [&] () {x = newton(p.x0,tol,max_iter,1u,f);};  // one worker, so the time is comparable
+
+    track(p.f,0.0);
+    f = &tracked;
+    sd();
+    f = p.f;
+    report(out,"steepest_descent",p,x,time_per_run(sd));
+
+    track(p.f,0.0);
+    f = &tracked;
+    sdg();
+    f = p.f;
+    report(out,"steepest_descent_gradient",p,x,time_per_run(sdg));
+
+    track(p.f,0.0);
+    f = &tracked;
+    nt();
+    f = p.f;
+    report(out,"newton",p,x,time_per_run(nt));
+
+  }
+
+  // One-dimensional methods
+  double xq = 0.0;
+  double (*f1)(const double) = &quartic;
+  auto g1 = [&] () {xq = gss(0.5,0.0,4.0,1.0e-8,f1);};
+  tracked_f1 = &quartic;
+  tracked_evals = 0;
+  f1 = &tracked1;
+  g1();
+  f1 = &quartic;
+  bench_record(out,"optimizer").add("optimizer","gss").add("function","quartic").add("n",1LL).add("evals",tracked_evals)
+    .add("wall_s",time_per_run(g1)).add("f",quartic(xq)).add("x_error",fabs(xq-2.25)).flag("converged",fabs(xq-2.25)<1.0e-6);
+
+  // secant finds the root of the slope, so its evaluations are of the slope
+  f1 = &quartic_slope;
+  auto s1 = [&] () {xq = secant(3.0,1.0e-10,100,f1);};
+  tracked_f1 = &quartic_slope;
+  tracked_evals = 0;
+  f1 = &tracked1;
+  s1();
+  f1 = &quartic_slope;
+  bench_record(out,"optimizer").add("optimizer","secant").add("function","quartic").add("n",1LL).add("evals",tracked_evals)
+    .add("wall_s",time_per_run(s1)).add("f",quartic(xq)).add("x_error",fabs(xq-2.25)).flag("converged",fabs(xq-2.25)<1.0e-6);
+
+  return 0;
+
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "remote_tools.h"
+#include "file_ops.h"
+#include "bench.h"
+
+using namespace std;
+
+// Host (CPPOPT_BENCH_HOST, default localhost) and size of the large file in MiB (CPPOPT_BENCH_MB, default 64)
+string bench_host() {
+  const char* host = getenv("CPPOPT_BENCH_HOST");
+  return (host!=NULL) ? string(host) : string("localhost");
+}
+
+size_t bench_mb() {
+  const char* mb = getenv("CPPOPT_BENCH_MB");
+  return (mb!=NULL && atoi(mb)>0) ? static_cast<size_t>(atoi(mb)) : 64;
+}
+
+void write_file(const string name, const size_t mb) {
+  vector<char> block(1048576);
+  for (size_t i=0; i<block.size(); ++i) {
+    block[i] = static_cast<char>(i*2654435761u >> 24);
+  }
+  FILE* fp = fopen(name.c_str(),"wb");
+  for (size_t i=0; i<mb; ++i) {
+    fwrite(block.data(),1,block.size(),fp);
+  }
+  fclose(fp);
+}
+
+void report(ostream& out, const string& host, const string op, const size_t bytes, const double seconds) {
+  bench_record(out,"ssh").add("host",host).add("op",op).add("bytes",static_cast<long long>(bytes))
+    .add("wall_s",seconds).add("mb_per_s",bytes/1048576.0/seconds);
+}
+
+int main(int argc, char** argv) {
+
+  ostream& out = bench_output(argc,argv);
+  const string host = bench_host();
+  const size_t mb = bench_mb();
+  const size_t nfiles = 16;
+
+  connection ssh_connection;
+  try {
+    ssh_connection.open_connection(host);
+  }
+  catch (const cppopt_error& e) {
+    // Nothing to measure without a server
+    bench_record(out,"ssh").add("host",host).flag("skipped",true).add("reason",string(e.what()));
+    return 0;
+  }
+  ssh_connection.exec("mkdir -p cppopt_bench/many");
+
+  // One large file each way
+  write_file("bench_big.bin",mb);
+  auto start = chrono::steady_clock::now();
+  ssh_connection.put_file("bench_big.bin","cppopt_bench");
+  report(out,host,"put_file",mb*1048576,seconds_since(start));
+
+  start = chrono::steady_clock::now();
+  ssh_connection.get_file("bench_big.bin","cppopt_bench","bench_big_back.bin");
+  report(out,host,"get_file",mb*1048576,seconds_since(start));
+
+  // Many smaller files, pipelined over SFTP
+  make_dir("bench_many");
+  transfer_list uploads, downloads;
+  for (size_t i=0; i<nfiles; ++i) {
+    ostringstream name;
+    name << "file_" << i << ".bin";
+    write_file("bench_many/" + name.str(),mb/nfiles+1);
+    uploads.push_back(make_pair("bench_many/" + name.str(),"cppopt_bench/many/" + name.str()));
+    downloads.push_back(make_pair("cppopt_bench/many/" + name.str(),"bench_many/" + name.str() + ".back"));
+  }
+  size_t many_bytes = nfiles*(mb/nfiles+1)*1048576;
+  start = chrono::steady_clock::now();
+  ssh_connection.put_files(uploads);
+  report(out,host,"put_files",many_bytes,seconds_since(start));
+
+  start = chrono::steady_clock::now();
+  ssh_connection.get_files(downloads);
+  report(out,host,"get_files",many_bytes,seconds_since(start));
+
+  // The same tree as one compressed stream
+  for (auto& f : downloads) {
+    remove(f.second.c_str());
+  }
+  start = chrono::steady_clock::now();
+  ssh_connection.put_dir("bench_many","cppopt_bench/tree");
+  report(out,host,"put_dir",many_bytes,seconds_since(start));
+
+  start = chrono::steady_clock::now();
+  ssh_connection.get_dir("cppopt_bench/tree","bench_tree");
+  report(out,host,"get_dir",many_bytes,seconds_since(start));
+
+  ssh_connection.exec("rm -rf cppopt_bench");
+  ssh_connection.close_connection();
+  remove("bench_big.bin");
+  remove("bench_big_back.bin");
+  remove_tree("bench_many");
+  remove_tree("bench_tree");
+
+  return 0;
+
+}
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include "steepest_descent.h"
+#include "file_ops.h"
+
+using namespace std;
+
+int nevals = 0;
+
+// Stands in for a solver which writes its adjoint gradient next to the result
+template <typename T>
+T bowl(const std::vector<T>& X) {
+  ++nevals;
+  T F = 0.0;
+  ofstream out("gradient.dat");
+  out << "# adjoint sensitivities\n";
+  for (size_t i=0; i<X.size(); ++i) {
+    T c = 1.0 + 0.05*i;
+    F += c*pow(X[i]-1.0,2);
+    out << 2.0*c*(X[i]-1.0) << "\n";
+  }
+  return F;
+}
+
+template <typename T>
+std::vector<T> bowl_gradient(const std::vector<T>& X) {
+  return read_vector<T>("gradient.dat",1,X.size());
+}
+
+int main() {
+
+  std::vector<double> x(20,3.0);
+
+  nevals = 0;
+  std::vector<double> x_fdm = steepest_descent<double>(x,1.0e-6,200,&bowl<double>);
+  cout << "Finite differences: f(x_opt) = " << bowl(x_fdm) << " after " << nevals << " evaluations" << endl;
+
+  nevals = 0;
+  std::vector<double> x_adj = steepest_descent<double>(x,1.0e-6,200,&bowl<double>,&bowl_gradient<double>);
+  cout << "Adjoint gradient:   f(x_opt) = " << bowl(x_adj) << " after " << nevals << " evaluations" << endl;
+
+  // Other layouts: a column of a table (with Fortran exponents) and raw binary
+  {
+    ofstream out("sens.dat");
+    out << "  i   dF/dx\n";
+    for (int i=0; i<5; ++i) {
+      out << "  " << i << "   " << i << ".5D-03\n";
+    }
+    out << "\n  total   1.0\n";
+  }
+  std::vector<double> col = read_column<double>("sens.dat",1,1);
+  cout << "Column:";
+  for (auto v : col) {
+    cout << " " << v;
+  }
+  cout << " (" << col.size() << " values, should be 5)" << endl;
+
+  std::vector<double> big(1000000);
+  for (size_t i=0; i<big.size(); ++i) {
+    big[i] = 1.0/(i+1);
+  }
+  FILE* fp = fopen("sens.bin","wb");
+  fwrite(big.data(),sizeof(double),big.size(),fp);
+  fclose(fp);
+  std::vector<double> bin = read_binary_vector<double>("sens.bin");
+  cout << "Binary: " << bin.size() << " values, last = " << bin.back() << " (should be 1e-06)" << endl;
+
+  remove("gradient.dat");
+  remove("sens.dat");
+  remove("sens.bin");
+
+  return 0;
+
+}
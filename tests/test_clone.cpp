@@ -0,0 +1,71 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <sys/stat.h>
+#include "file_ops.h"
+
+using namespace std;
+
+string contents(const string name) {
+  ifstream in(name.c_str());
+  string s;
+  getline(in,s);
+  return s;
+}
+
+int main() {
+
+  // Making a case with a read-only mesh, a subdirectory and a symlink
+  char tmpl[] = "/tmp/cppopt_clone_XXXXXX";
+  string root = mkdtemp(tmpl);
+  string src = root + "/case";
+  make_dir(src);
+  make_dir(src + "/sub");
+  for (int i=0; i<6; ++i) {
+    ofstream out((src + "/sub/file_" + to_string(i) + ".dat").c_str());
+    out << "file " << i << endl;
+  }
+  ofstream(src + "/mesh.cas") << "mesh" << endl;
+  chmod((src + "/mesh.cas").c_str(),0444);
+  ofstream(src + "/input.jou") << "original" << endl;
+  symlink("input.jou",(src + "/input.lnk").c_str());
+
+  // Cloning (read-only files are hard linked)
+  clone_tree(src,root + "/clone");
+  struct stat a, b;
+  stat((src + "/mesh.cas").c_str(),&a);
+  stat((root + "/clone/mesh.cas").c_str(),&b);
+  cout << "Mesh hard linked: " << (a.st_ino==b.st_ino) << endl;
+  cout << "sub/file_5.dat: " << contents(root + "/clone/sub/file_5.dat") << endl;
+  cout << "input.lnk: " << contents(root + "/clone/input.lnk") << endl;
+
+  // Copying over a hard link replaces it instead of writing through it
+  ofstream(root + "/new.cas") << "new" << endl;
+  place_file(root + "/new.cas",root + "/clone/mesh.cas",copy_method_copy);
+  cout << "Source mesh after copying over its link: " << contents(src + "/mesh.cas") << " (should be mesh)" << endl;
+
+  // Same with copy_file directly, and the copy of a read-only file can be overwritten later
+  clone_tree(src,root + "/clone2");
+  copy_file(root + "/new.cas",root + "/clone2/mesh.cas");
+  cout << "Source mesh after copy_file over its link: " << contents(src + "/mesh.cas") << " (should be mesh)" << endl;
+  copy_file(src + "/mesh.cas",root + "/mesh_copy.cas");
+  stat((root + "/mesh_copy.cas").c_str(),&b);
+  cout << "Copy of the read-only mesh is writable: " << ((b.st_mode & S_IWUSR)!=0) << endl;
+
+  // A copy which fails is rethrown in the caller (a file is in the way of a directory)
+  make_dir(root + "/bad_clone");
+  ofstream(root + "/bad_clone/sub") << "in the way" << endl;
+  try {
+    clone_tree(src,root + "/bad_clone");
+    cout << "No error (wrong)" << endl;
+  }
+  catch (file_error& e) {
+    cout << "Caught: " << e.what() << endl;
+  }
+
+  remove_tree(root);
+
+  return 0;
+
+}
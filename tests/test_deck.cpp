@@ -0,0 +1,54 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include "replace_string.h"
+#include "executor.h"
+
+using namespace std;
+
+int main() {
+
+  // Template of a deck which a solver reads from stdin
+  input_deck deck = input_deck::from_string("x = XVAR\ny = YVAR\nscale = XVAR\n");
+
+  // The "solver" reads the deck from stdin and prints f = (x-1)^2 + (y+2)^2
+  string solver = "awk '/^x/ {x=$3} /^y/ {y=$3} END {print \"f\", (x-1)^2 + (y+2)^2}'";
+
+  local_executor ex;
+  for (int i=0; i<3; ++i) {
+    deck.set("XVAR",1.0*i);
+    deck.set("YVAR",-1.0*i);
+    exec_options opts;
+    opts.input = deck.render();
+    exec_result r = ex.run(solver,opts);
+
+    // The result is read straight from the captured output
+    istringstream out(r.out);
+    cout << "x = " << i << ", y = " << -i << ", f = " << get_value<double>(out,0,1) << endl;
+  }
+
+  // Large decks go through the pipe too
+  string big;
+  for (int i=0; i<100000; ++i) {
+    big += "line XVAR\n";
+  }
+  input_deck big_deck = input_deck::from_string(big);
+  big_deck.set("XVAR",3.5);
+  exec_options opts;
+  opts.input = big_deck.render();
+  auto start = chrono::steady_clock::now();
+  exec_result r = ex.run("wc -l",opts);
+  cout << "wc read " << r.out.substr(0,r.out.find('\n')) << " lines (should be 100000) in " << chrono::duration<double>(chrono::steady_clock::now()-start).count() << " s" << endl;
+
+  // A solver which stops reading early doesn't take us down with it
+  r = ex.run("head -c 10 > /dev/null",opts);
+  cout << "exit status: " << r.exit_status << " (should be 0)" << endl;
+
+  // In-memory replace
+  string text("a = AVAR, b = AVAR");
+  size_t n = replace_var_str(text,"AVAR",2.0);
+  cout << text << " (" << n << " replaced)" << endl;
+
+  return 0;
+
+}
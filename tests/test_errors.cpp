@@ -0,0 +1,59 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include "errors.h"
+#include "file_ops.h"
+#include "executor.h"
+
+using namespace std;
+
+int main() {
+
+  // A missing file is reported with an exception instead of exiting
+  try {
+    get_value<double>("does_not_exist.dat",0,0);
+  }
+  catch (const cppopt_error& e) {
+    cout << "Caught: " << e.what() << endl;
+  }
+
+  // A value which isn't where it's expected is a parse_error
+  try {
+    istringstream in("alpha beta\n");
+    get_value<double>(in,0,1);
+  }
+  catch (const parse_error& e) {
+    cout << "Caught parse_error: " << e.what() << endl;
+  }
+
+  // Transient errors are retried with backoff (succeeds on the third try)
+  retry_policy policy;
+  policy.initial_delay_ms = 20;
+  int calls = 0;
+  auto start = chrono::steady_clock::now();
+  int value = with_retry([&calls] () {
+    if (++calls<3) {
+      throw remote_error("Connection dropped",true);
+    }
+    return 42;
+  },policy,[] (const remote_error& e, unsigned int attempt) {
+    cout << "Attempt " << attempt << " failed (" << e.what() << "), retrying" << endl;
+  });
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+  cout << "Got " << value << " after " << calls << " calls in " << elapsed << " s" << endl;
+
+  // Errors which aren't transient are passed on right away
+  calls = 0;
+  try {
+    with_retry([&calls] () {
+      ++calls;
+      throw remote_error("Permission denied");
+    },policy);
+  }
+  catch (const remote_error& e) {
+    cout << "Gave up after " << calls << " call: " << e.what() << endl;
+  }
+
+  return 0;
+
+}
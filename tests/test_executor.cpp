@@ -0,0 +1,49 @@
+#include <iostream>
+#include <sstream>
+#include "executor.h"
+
+using namespace std;
+
+// Objective function which doesn't know where the case runs.  On a
+// cluster the same function is called with an ssh_executor.
+double obj_func(executor& ex, double x) {
+
+  ex.stage("Tavg.dat","case");
+
+  // Standing in for a solver: writes a report with (x-2)^2 in it
+  ostringstream cmd;
+  cmd << "cd case && awk -v x=" << x << " 'BEGIN {print \"Net\", (x-2)*(x-2)}' > report.txt";
+  exec_result r = ex.run(cmd.str());
+  if (r.exit_status!=0) {
+    cerr << r.err;
+    return 1.0e10;
+  }
+
+  return ex.get<double>("case/report.txt","Net",1);
+
+}
+
+int main() {
+
+  local_executor ex;
+
+  for (double x=0.0; x<=4.0; x+=1.0) {
+    cout << "f(" << x << ") = " << obj_func(ex,x) << endl;
+  }
+
+  // Reading from a staged file, same as get_value
+  cout << "Tavg = " << ex.get<double>("case/Tavg.dat",7,1) << " K" << endl;
+
+  // Exit status, stderr and timeouts
+  exec_result r = ex.run("echo to stderr 1>&2; exit 3");
+  cout << "exit status: " << r.exit_status << " (should be 3), stderr: " << r.err;
+  exec_options opts;
+  opts.timeout_ms = 200;
+  r = ex.run("sleep 5",opts);
+  cout << "timed out: " << r.timed_out << " (should be 1)" << endl;
+
+  remove_tree("case");
+
+  return 0;
+
+}
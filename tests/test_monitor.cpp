@@ -0,0 +1,50 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "output_monitor.h"
+
+using namespace std;
+
+int main() {
+
+  // Forking a fake solver which writes a residual history forever
+  pid_t pid = fork();
+  if (pid==0) {
+    ofstream out("residuals.dat");
+    out << "iter residual" << endl;
+    for (int i=0; ; ++i) {
+      out << i << " " << exp(-0.5*i) << endl;
+      usleep(10000);
+    }
+  }
+
+  // Stopping the solver once the residual drops below 1e-6
+  output_monitor monitor(50);
+  value_selector sel = {1, 1, true};
+  int id = monitor.add_watch("residuals.dat", sel,
+      [] (const vector<double>& r) {return r.back()<1.0e-6;}, pid);
+
+  bool status = monitor.wait(id,20000);
+  waitpid(pid,NULL,0);
+  vector<double> r = monitor.history(id);
+
+  cout << "Converged: " << status << " after " << r.size() << " iterations." << endl;
+  cout << "Final residual = " << r.back() << endl;
+
+  // A predicate which throws is reported and doesn't stop the monitor
+  int bad = monitor.add_watch("residuals.dat", sel,
+      [] (const vector<double>&) -> bool {throw runtime_error("garbled residual");});
+  monitor.wait(bad,500);
+  monitor.remove_watch(bad);
+  cout << "Still running after a throwing predicate." << endl;
+
+  remove("residuals.dat");
+
+  return 0;
+
+}
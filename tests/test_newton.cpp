@@ -0,0 +1,76 @@
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "newton.h"
+#include "steepest_descent.h"
+
+using namespace std;
+
+atomic<int> nevals(0);
+
+template <typename T>
+T rosenbrock(const std::vector<T>& X) {
+  T x = X[0];
+  T y = X[1];
+  return pow(1.0 - x,2) + 100.0*pow(y-x*x,2);
+}
+
+// Stands in for a solver which fails to converge (its output is NaN) for x < 0
+template <typename T>
+T fragile(const std::vector<T>& X) {
+  return (X[0]<0.0) ? NAN : pow(X[0]-2.0,2) + pow(X[1],2);
+}
+
+// Stands in for a solver which takes 20 ms per run
+template <typename T>
+T slow_calibration(const std::vector<T>& X, const double scale) {
+  ++nevals;
+  this_thread::sleep_for(chrono::milliseconds(20));
+  T F = 0.0;
+  for (size_t i=0; i<X.size(); ++i) {
+    T c = scale*(i+1);
+    F += c*pow(X[i]-1.0/(i+1),2) + 0.1*pow(X[i],4);
+  }
+  return F + 0.5*X[0]*X[1];
+}
+
+int main() {
+
+  // Finite difference Hessian of the Rosenbrock function
+  std::vector<double> x({1.0,2.0});
+  std::vector<double> dx({1.0e-4,1.0e-4});
+  std::vector<double> g;
+  std::vector<std::vector<double> > H = hess_fdm(x,rosenbrock(x),dx,g,0,&rosenbrock<double>);
+  cout << "Numerical Hessian: " << H[0][0] << " " << H[0][1] << " / " << H[1][0] << " " << H[1][1] << endl;
+  cout << "Exact Hessian:     " << 1200.0*x[0]*x[0]-400.0*x[1]+2.0 << " " << -400.0*x[0] << " / " << -400.0*x[0] << " " << 200.0 << endl;
+  cout << "Gradient: " << g[0] << " " << g[1] << " (should be -400 200)" << endl;
+
+  // Newton on the Rosenbrock function
+  std::vector<double> x0({-1.2,1.0});
+  std::vector<double> x_opt = newton(x0,1.0e-6,100,0,&rosenbrock<double>);
+  cout << "Rosenbrock: x_opt = (" << x_opt[0] << ", " << x_opt[1] << "), f = " << rosenbrock(x_opt) << endl;
+
+  // NaN in the Hessian at the starting point has to stop the iteration instead of hanging it
+  std::vector<double> f0({0.0,1.0});
+  std::vector<double> f_opt = newton(f0,1.0e-6,100,0,&fragile<double>);
+  cout << "Fragile: x_opt = (" << f_opt[0] << ", " << f_opt[1] << ") (should be the starting point, 0 1)" << endl;
+
+  // A calibration problem where each evaluation is slow
+  std::vector<double> c0(4,2.0);
+  auto start = chrono::steady_clock::now();
+  nevals = 0;
+  std::vector<double> c_opt = newton(c0,1.0e-6,50,0,&slow_calibration<double>,1.0);
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+  cout << "Newton: f = " << slow_calibration(c_opt,1.0) << " after " << nevals-1 << " evaluations in " << elapsed << " s" << endl;
+
+  start = chrono::steady_clock::now();
+  nevals = 0;
+  std::vector<double> s_opt = steepest_descent(c0,1.0e-6,5,&slow_calibration<double>,1.0);
+  elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+  cout << "Steepest descent (5 iterations): f = " << slow_calibration(s_opt,1.0) << " after " << nevals-1 << " evaluations in " << elapsed << " s" << endl;
+
+  return 0;
+
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <future>
+#include <chrono>
+#include "process_pool.h"
+
+using namespace std;
+
+int main() {
+
+  // Two jobs at a time, each pinned to its own core
+  process_pool pool(2,pin_cores,1);
+
+  // Each job reports the cpus it may run on
+  vector<future<process_result> > results;
+  auto start = chrono::steady_clock::now();
+  for (int i=0; i<6; ++i) {
+    ostringstream out;
+    out << "job_" << i << ".out";
+    process_options opts;
+    opts.stdout_file = out.str();
+    results.push_back(pool.submit("grep Cpus_allowed_list /proc/self/status; sleep 0.2",opts));
+  }
+
+  // The optimizer thread is free while the jobs run
+  cout << "Submitted 6 jobs in " << chrono::duration<double>(chrono::steady_clock::now()-start).count() << " s." << endl;
+
+  for (int i=0; i<6; ++i) {
+    process_result r = results[i].get();
+    ostringstream name;
+    name << "job_" << i << ".out";
+    ifstream in(name.str().c_str());
+    string line;
+    getline(in,line);
+    cout << "job " << i << ": exit status " << r.exit_status << ", " << r.wall_s << " s, " << line << endl;
+    remove(name.str().c_str());
+  }
+  cout << "All jobs took " << chrono::duration<double>(chrono::steady_clock::now()-start).count() << " s (should be about 0.6 s)." << endl;
+
+  // A job which ignores SIGTERM is killed after the grace period
+  process_options opts;
+  opts.timeout_ms = 200;
+  opts.grace_ms = 200;
+  process_result r = pool.submit("trap '' TERM; sleep 5",opts).get();
+  cout << "timed out: " << r.timed_out << ", signal: " << r.signal << " (should be 1, 9), " << r.wall_s << " s" << endl;
+
+  // Exit codes
+  r = pool.submit("exit 7").get();
+  cout << "exit status: " << r.exit_status << " (should be 7)" << endl;
+
+  return 0;
+
+}
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <set>
+#include "run_pool.h"
+
+using namespace std;
+
+string first_line(const string name) {
+  ifstream in(name.c_str());
+  string s;
+  getline(in,s);
+  return s;
+}
+
+int main() {
+
+  // Making a template case
+  make_dir("case_template");
+  ofstream deck("case_template/input.jou");
+  deck << "velocity = fleece" << endl;
+  deck.close();
+
+  // Provisioning the pool (use a root in /dev/shm to keep cases on tmpfs)
+  run_dir_pool pool("case_template","cases",4);
+
+  set<string> used;
+  for (int i=0; i<8; ++i) {
+    scoped_run_dir run(pool);
+    if (first_line(run.path() + "/input.jou")!="velocity = fleece") {
+      cout << "ERROR: " << run.path() << "/input.jou wasn't reset: " << first_line(run.path() + "/input.jou") << endl;
+    }
+    replace_var(run.path() + "/input.jou","fleece",1.5*i);
+    ofstream out((run.path() + "/output.dat").c_str());
+    out << "result " << i << endl;
+    cout << "Evaluation " << i << " ran in " << run.path() << endl;
+    used.insert(run.path());
+  }
+
+  // In every directory which was used, input.jou should be reset and output.dat removed
+  cout << "Pool has " << pool.size() << " case directories." << endl;
+  for (auto& dir : used) {
+    cout << dir << ": input.jou = \"" << first_line(dir + "/input.jou") << "\" (should be velocity = fleece), output.dat exists: "
+         << accessible(dir + "/output.dat") << " (should be 0)" << endl;
+  }
+
+  // A directory which can't be reset (its template file is gone) is cloned again on the next acquire
+  {
+    scoped_run_dir run(pool);
+    replace_var(run.path() + "/input.jou","fleece",99.0);
+    rename("case_template/input.jou","input.jou.moved");
+  }
+  rename("input.jou.moved","case_template/input.jou");
+  {
+    scoped_run_dir run(pool);
+    cout << "After a failed reset " << run.path() << "/input.jou = \"" << first_line(run.path() + "/input.jou") << "\" (should be velocity = fleece)" << endl;
+  }
+
+  remove_tree("case_template");
+
+  return 0;
+
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include "host_scheduler.h"
+
+using namespace std;
+
+// Stands in for an executor on a cluster with a given evaluation time (and, if set, a command which replaces every command)
+class slow_executor : public local_executor {
+  public:
+    slow_executor(const double seconds, const string broken="") : seconds(seconds), broken(broken) {}
+    exec_result run(const std::string cmd, const exec_options opts=exec_options()) {
+      ostringstream full;
+      full << "sleep " << seconds << "; " << (broken.empty() ? cmd : broken);
+      return local_executor::run(full.str(),opts);
+    }
+  private:
+    double seconds;
+    string broken;
+};
+
+// Evaluates x^2 through the executor
+bool eval(executor& ex, const double& x, double& fx) {
+  ostringstream cmd;
+  cmd << "awk 'BEGIN {print " << x << "*" << x << "}'";
+  exec_result r = ex.run(cmd.str());
+  if (r.exit_status!=0) {
+    return false;
+  }
+  fx = boost::lexical_cast<double>(r.out.substr(0,r.out.find('\n')));
+  return true;
+}
+
+// Same, but the point x = 3 always fails (e.g., the solver diverges there)
+bool picky_eval(executor& ex, const double& x, double& fx) {
+  if (x==3.0) {
+    throw std::runtime_error("diverged");
+  }
+  return eval(ex,x,fx);
+}
+
+int main() {
+
+  // A fast host, a host which is four times slower, a host which always
+  // fails and a host whose output can't be parsed (eval throws)
+  slow_executor fast(0.05), slow(0.2), broken(0.01,"exit 1"), garbled(0.01,"echo garbage");
+  host_scheduler<double,double> sched;
+  sched.add_host("fast",fast,4);
+  sched.add_host("slow",slow,4);
+  sched.add_host("broken",broken,2);
+  sched.add_host("garbled",garbled,2);
+
+  vector<double> points;
+  for (int i=0; i<40; ++i) {
+    points.push_back(0.5*i);
+  }
+
+  for (int batch=0; batch<3; ++batch) {
+    auto start = chrono::steady_clock::now();
+    vector<double> f = sched.run(points,eval);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    bool right = true;
+    for (size_t i=0; i<points.size(); ++i) {
+      right = right && (f[i]==points[i]*points[i]);
+    }
+    cout << "batch " << batch << ": " << elapsed << " s, results " << (right ? "correct" : "WRONG") << endl;
+  }
+
+  // Round robin would take about 10*0.2 = 2 s per batch; the best split is about 0.4 s
+  sched.report();
+
+  // One bad point mustn't drop the healthy hosts or lose the other results
+  slow_executor a(0.01), b(0.01);
+  host_scheduler<double,double> two;
+  two.add_host("a",a,2);
+  two.add_host("b",b,2);
+  vector<double> twenty(points.begin(),points.begin()+20);
+  vector<double> f = two.run(twenty,picky_eval);
+  size_t nok = 0;
+  for (size_t i=0; i<twenty.size(); ++i) {
+    nok += (two.succeeded()[i] && f[i]==twenty[i]*twenty[i]) ? 1 : 0;
+  }
+  cout << nok << " of 20 points evaluated (should be 19)" << endl;
+  two.report();
+
+  return 0;
+
+}
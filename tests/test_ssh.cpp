@@ -1,4 +1,5 @@
 #include <iostream>
+#include <vector>
 #include "remote_tools.h"
 
 using namespace std;
@@ -10,7 +11,7 @@ int main() {
   ssh_connection.open_connection("username@somehost");
 
   // Listing contents of the home directory
-  ssh_connection.list_dir("$HOME")
+  ssh_connection.list_dir("$HOME");
 
   // Checking the existence of a file in a given directory
   bool status = ssh_connection.check_file_existence("$HOME",".bashrc");
@@ -21,12 +22,24 @@ int main() {
     cout << "Your bashrc does not exist." << std::endl;
   }
 
+  // Checking many files at once
+  vector<string> paths({"$HOME/.bashrc","$HOME/.profile","$HOME/does_not_exist"});
+  vector<remote_stat> stats = ssh_connection.stat_files(paths);
+  for (auto& st : stats) {
+    cout << st.path << " exists: " << st.exists << " size: " << st.size << endl;
+  }
+
   // Transferring a file
   ssh_connection.put_file("test","$HOME");
 
   // Getting a file from the remote machine
   ssh_connection.get_file("some_file","$HOME","some_file");
 
+  // Reading values from a remote report without transferring it
+  double drag = ssh_connection.get_remote_value<double>("$HOME/report.txt",3,2);
+  double net = ssh_connection.get_remote_value<double>("$HOME/report.txt","Net",1);
+  cout << "line 3, field 2: " << drag << ", Net: " << net << endl;
+
   // Closing the connection
   ssh_connection.close_connection();
 
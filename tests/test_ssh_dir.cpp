@@ -0,0 +1,88 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sys/stat.h>
+#include "remote_tools.h"
+
+using namespace std;
+
+// Makes n files of the given size in dir
+void make_files(const string dir, const unsigned int n, const size_t size, vector<string>& names) {
+  mkdir(dir.c_str(),0777);
+  string data(size,'x');
+  for (size_t i=0; i<size; i+=64) {
+    data[i] = '\n';
+  }
+  for (unsigned int i=0; i<n; ++i) {
+    ostringstream name;
+    name << dir << "/file_" << i;
+    ofstream out(name.str().c_str());
+    out << data;
+    names.push_back(name.str());
+  }
+}
+
+int main() {
+
+  string target = "username@somehost";
+
+  // Many small files and a few large ones
+  vector<string> small, large;
+  make_files("bench_small",1000,4096,small);
+  make_files("bench_large",4,67108864,large);
+
+  // Output is CSV: case,method,seconds
+  for (int compress=0; compress<2; ++compress) {
+
+    connection ssh_connection;
+    if (compress) {
+      ssh_connection.set_compression(6);
+    }
+    ssh_connection.open_connection(target);
+    string transport = compress ? "+ssh_zlib" : "";
+
+    for (int c=0; c<2; ++c) {
+      string name = c ? "large" : "small";
+      string dir = "bench_" + name;
+      vector<string>& files = c ? large : small;
+      ssh_connection.exec("rm -rf bench_remote && mkdir -p bench_remote");
+
+      // One put_file per file
+      auto start = chrono::steady_clock::now();
+      for (auto& f : files) {
+        ssh_connection.put_file(f,"bench_remote");
+      }
+      double t_scp = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+      // One tar stream, uncompressed and at a few gzip levels
+      vector<double> t_tar;
+      int levels[] = {0,1,6};
+      for (int level : levels) {
+        ssh_connection.exec("rm -rf bench_remote");
+        start = chrono::steady_clock::now();
+        ssh_connection.put_dir(dir,"bench_remote",level);
+        t_tar.push_back(chrono::duration<double>(chrono::steady_clock::now()-start).count());
+      }
+
+      cout << name << ",scp" << transport << "," << t_scp << endl;
+      for (unsigned int i=0; i<t_tar.size(); ++i) {
+        cout << name << ",tar_gzip" << levels[i] << transport << "," << t_tar[i] << endl;
+      }
+    }
+
+    // And back again
+    auto start = chrono::steady_clock::now();
+    ssh_connection.get_dir("bench_remote","bench_back",1);
+    cout << "large,get_dir_gzip1" << transport << "," << chrono::duration<double>(chrono::steady_clock::now()-start).count() << endl;
+
+    ssh_connection.exec("rm -rf bench_remote");
+    ssh_connection.close_connection();
+
+  }
+
+  return 0;
+
+}
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <vector>
+#include "remote_tools.h"
+
+using namespace std;
+
+int main() {
+
+  // Creating connection
+  connection ssh_connection;
+  ssh_connection.open_connection("username@somehost");
+
+  // Running a command and capturing its output
+  exec_result r = ssh_connection.exec("uname -a; echo oops 1>&2; exit 3");
+  cout << "stdout: " << r.out;
+  cout << "stderr: " << r.err;
+  cout << "exit status: " << r.exit_status << " (should be 3)" << endl;
+
+  // A command which runs too long is killed
+  exec_options opts;
+  opts.timeout_ms = 500;
+  r = ssh_connection.exec("sleep 10",opts);
+  cout << "timed out: " << r.timed_out << " (should be 1)" << endl;
+
+  // Feeding a deck to a command's stdin (no files on either side)
+  exec_options in_opts;
+  in_opts.input = "x = 1.5\ny = 2.5\n";
+  r = ssh_connection.exec("awk '{s += $3} END {print s}'",in_opts);
+  cout << "sum: " << r.out << " (should be 4)" << endl;
+
+  // Several commands running at once over the same session
+  vector<remote_command> commands;
+  for (int i=0; i<4; ++i) {
+    commands.push_back(ssh_connection.exec_async("sleep 1; hostname"));
+  }
+  remote_command::wait_all(commands);
+  for (auto& c : commands) {
+    cout << c.result().out;
+  }
+
+  // Closing the connection
+  ssh_connection.close_connection();
+
+  return 0;
+
+}
@@ -0,0 +1,41 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include "remote_jobs.h"
+
+using namespace std;
+
+int main() {
+
+  // Works against a local sshd (needs key based login to localhost)
+  string target = "username@localhost";
+
+  // Two sessions, at most 50 jobs running at once
+  remote_job_manager jobs(2);
+  jobs.set_host_limit(target,50);
+
+  // Submitting a few hundred jobs which each sleep for a second
+  unsigned int njobs = 200;
+  unsigned int nfailed = 0;
+  auto start = chrono::steady_clock::now();
+  for (unsigned int i=0; i<njobs; ++i) {
+    ostringstream cmd;
+    cmd << "sleep 1; echo " << i;
+    jobs.submit(target,cmd.str(),[&nfailed] (unsigned int id, const exec_result& r) {
+      if (r.exit_status!=0) {
+        ++nfailed;
+      }
+      if (id%50==0) {
+        cout << "job " << id << " printed " << r.out;
+      }
+    });
+  }
+
+  // One thread supervises all of them
+  jobs.run();
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+  cout << njobs << " jobs finished in " << elapsed << " s (should be about " << njobs/50 << " s), " << nfailed << " failed." << endl;
+
+  return 0;
+
+}
@@ -0,0 +1,27 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "connection_pool.h"
+
+using namespace std;
+
+int main() {
+
+  // Keeping up to 4 sessions open to the host
+  connection_pool pool(4);
+
+  // Each thread checks out its own session, so they run at the same time
+  vector<thread> threads;
+  for (int i=0; i<8; ++i) {
+    threads.push_back(thread([&pool] () {
+      pooled_connection conn = pool.checkout("username@somehost");
+      conn->list_dir("$HOME");
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  return 0;
+
+}
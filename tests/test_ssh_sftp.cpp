@@ -0,0 +1,36 @@
+#include <iostream>
+#include <sstream>
+#include "remote_tools.h"
+
+using namespace std;
+
+int main() {
+
+  // Creating connection
+  connection ssh_connection;
+  ssh_connection.open_connection("username@somehost");
+
+  // Sending a batch of files (remote paths are relative to the home directory)
+  transfer_list uploads;
+  for (int i=0; i<16; ++i) {
+    ostringstream name;
+    name << "input_" << i << ".dat";
+    uploads.push_back(make_pair(name.str(),"case/" + name.str()));
+  }
+  sftp_options opts;
+  opts.max_requests = 128;
+  ssh_connection.put_files(uploads,opts);
+
+  // Getting them back
+  transfer_list downloads;
+  for (auto& f : uploads) {
+    downloads.push_back(make_pair(f.second,f.first + ".back"));
+  }
+  ssh_connection.get_files(downloads,opts);
+
+  // Closing the connection
+  ssh_connection.close_connection();
+
+  return 0;
+
+}
@@ -0,0 +1,26 @@
+#include <iostream>
+#include "remote_tools.h"
+
+using namespace std;
+
+int main() {
+
+  // Creating connection
+  connection ssh_connection;
+  ssh_connection.open_connection("username@somehost");
+
+  // Only files that changed since the last sync are sent
+  sync_options opts;
+  opts.use_hash = true;
+  uint64_t sent = ssh_connection.sync_dir("case","runs/case",opts);
+  cout << "First sync sent " << sent << " bytes." << endl;
+
+  sent = ssh_connection.sync_dir("case","runs/case",opts);
+  cout << "Second sync sent " << sent << " bytes (should be 0)." << endl;
+
+  // Closing the connection
+  ssh_connection.close_connection();
+
+  return 0;
+
+}
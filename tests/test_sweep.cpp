@@ -0,0 +1,112 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <chrono>
+#include "sweep.h"
+
+using namespace std;
+
+int main() {
+
+  vector<sweep_param> params;
+  params.push_back(sweep_param("XVAR",-2.0,2.0,5));
+  params.push_back(sweep_param("YVAR",-1.0,3.0,3));
+
+  // Designs
+  sweep_design ff = full_factorial(params);
+  cout << "Full factorial: " << ff.size() << " points (should be 15), last = (" << ff.columns[0].back() << ", " << ff.columns[1].back() << ")" << endl;
+  sweep_design sob = sobol_design(params,4);
+  cout << "Sobol points:";
+  for (size_t i=0; i<sob.size(); ++i) {
+    cout << " (" << sob.columns[0][i] << ", " << sob.columns[1][i] << ")";
+  }
+  cout << endl;
+
+  // The "solver" reads the deck from stdin and prints the Rosenbrock function
+  input_deck deck = input_deck::from_string("x = XVAR\ny = YVAR\n");
+  string solver = "awk '/^x/ {x=$3} /^y/ {y=$3} END {print \"f\", (1-x)^2 + 100*(y-x^2)^2; print \"g\", x+y}'";
+  vector<remote_value> outputs;
+  outputs.push_back(remote_value("","f",1));
+  outputs.push_back(remote_value("",1,1));
+  vector<string> names;
+  names.push_back("f");
+  names.push_back("g");
+
+  local_executor ex;
+  vector<executor*> workers(4,&ex);
+  remove("sweep.journal");
+
+  // Latin hypercube, run all the way through
+  sweep_design lhs = latin_hypercube(params,2000);
+  sweep s(deck,solver,outputs,names);
+  s.set_journal("sweep.journal");
+  auto start = chrono::steady_clock::now();
+  sweep_table t = s.run(lhs,workers);
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+  const vector<double>& f = t.column("f");
+  size_t best = 0;
+  for (size_t i=0; i<t.size(); ++i) {
+    if (f[i]<f[best]) {
+      best = i;
+    }
+  }
+  cout << t.size() << " points in " << elapsed << " s (" << 1.0e3*elapsed/t.size() << " ms per point), best f = " << f[best] << " at (" << t.column("XVAR")[best] << ", " << t.column("YVAR")[best] << ")" << endl;
+
+  // Interrupting: keeping the first 500 points of the journal and a cut-off line
+  {
+    ifstream in("sweep.journal");
+    string line, kept;
+    for (int i=0; i<501 && getline(in,line); ++i) {
+      kept += line + "\n";
+    }
+    getline(in,line);
+    kept += line.substr(0,5);
+    in.close();
+    ofstream out("sweep.journal");
+    out << kept;
+  }
+  start = chrono::steady_clock::now();
+  sweep_table resumed = s.run(lhs,workers);
+  elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+  size_t same = 0;
+  for (size_t i=0; i<resumed.size(); ++i) {
+    same += (resumed.column("f")[i]==f[i]);
+  }
+  cout << "Resumed in " << elapsed << " s, " << same << " of " << resumed.size() << " results match" << endl;
+  resumed.write("sweep.dat");
+
+  // A journal from a different sweep is refused
+  try {
+    s.run(full_factorial(params),workers);
+  }
+  catch (const cppopt_error& e) {
+    cout << "Caught: " << e.what() << endl;
+  }
+
+  // Writing the deck to a file in each worker's directory instead
+  vector<local_executor> dirs;
+  for (int i=0; i<4; ++i) {
+    make_dir("sweep_case_" + to_string(i));
+    dirs.push_back(local_executor("sweep_case_" + to_string(i)));
+  }
+  vector<executor*> dir_workers;
+  for (auto& d : dirs) {
+    dir_workers.push_back(&d);
+  }
+  vector<remote_value> file_outputs;
+  file_outputs.push_back(remote_value("result.dat",0,1));
+  vector<string> file_names(1,"f");
+  sweep s2(deck,"awk '/^x/ {x=$3} /^y/ {y=$3} END {print \"f\", (1-x)^2 + 100*(y-x^2)^2}' deck.in > result.dat",file_outputs,file_names);
+  s2.set_deck_file("deck.in");
+  sweep_table t2 = s2.run(ff,dir_workers);
+  cout << "f(1,1) = " << t2.column("f")[10] << " (should be 0)" << endl;
+
+  for (int i=0; i<4; ++i) {
+    remove_tree("sweep_case_" + to_string(i));
+  }
+  remove("sweep.journal");
+  remove("sweep.dat");
+
+  return 0;
+
+}
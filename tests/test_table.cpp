@@ -0,0 +1,29 @@
+#include <iostream>
+#include "report_table.h"
+
+using namespace std;
+
+int main() {
+
+  // Indexing the report once
+  report_table table("Tavg.dat");
+
+  // Looking up values by row label and column header/position
+  double Tnet = table.get<double>("Net","(k)");
+  double Tfluid = table.get<double>("outer_fluid",1);
+
+  cout << "Tavg (Net) = " << Tnet << " K" << endl;
+  cout << "Tavg (outer_fluid) = " << Tfluid << " K" << endl;
+  cout << "Should be 1532.51 K." << endl;
+
+  // The label isn't a number
+  try {
+    table.get<double>("Net",0);
+  }
+  catch (const parse_error& e) {
+    cout << "Caught parse_error: " << e.what() << endl;
+  }
+
+  return 0;
+
+}
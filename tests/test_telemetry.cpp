@@ -0,0 +1,56 @@
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include "telemetry.h"
+#include "steepest_descent.h"
+#include "newton.h"
+#include "gss.h"
+
+using namespace std;
+
+template <typename T>
+T booth(const std::vector<T>& X) {
+  T x = X[0];
+  T y = X[1];
+  return pow(x+2.0*y-7.0,2) + pow(2.0*x+y-5.0,2);
+}
+
+double parabola(const double x) {
+  return (x-2.0)*(x-2.0);
+}
+
+double run_steepest(const int repeats) {
+  std::vector<double> x({5.0,2.2});
+  auto start = chrono::steady_clock::now();
+  for (int i=0; i<repeats; ++i) {
+    steepest_descent<double>(x,1.0e-6,5000,&booth<double>);
+  }
+  return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+int main() {
+
+  // Cost of the instrumentation with telemetry off and on (cheap objective, so it shows)
+  cout.setstate(ios::failbit);
+  double off = run_steepest(200);
+  telemetry::enable(true,1<<20);
+  double on = run_steepest(200);
+  cout.clear();
+  cout << "200 runs of steepest descent: " << off << " s off, " << on << " s on" << endl;
+  telemetry::reset();
+
+  // Recording one run of each optimizer
+  std::vector<double> x({5.0,2.2});
+  std::vector<double> x_sd = steepest_descent<double>(x,1.0e-6,5000,&booth<double>);
+  std::vector<double> x_nt = newton(x,1.0e-6,50,0,&booth<double>);
+  double x_gss = gss(0.0,-5.0,5.0,1.0e-6,&parabola);
+  cout << "steepest descent: (" << x_sd[0] << ", " << x_sd[1] << "), newton: (" << x_nt[0] << ", " << x_nt[1] << "), gss: " << x_gss << endl;
+
+  telemetry::report(cout);
+  telemetry::write_chrome_trace("trace.json");
+  telemetry::write_csv("trace.csv");
+  cout << "Wrote trace.json (open in chrome://tracing) and trace.csv" << endl;
+
+  return 0;
+
+}